@@ -0,0 +1,116 @@
+#include <math.h>
+#include "arith.h"
+#include "big.h"
+
+static int to_double(Eterm t, double *out) {
+    if (is_small(t)) {
+        *out = (double)small_value(t);
+    } else if (is_float(t)) {
+        *out = float_val(t);
+    } else if (is_big(t)) {
+        *out = big_to_double(t);
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+enum { FLOAT_PLUS, FLOAT_MINUS, FLOAT_TIMES, FLOAT_DIV };
+
+static Eterm float_op(Heap *heap, Eterm a, Eterm b, int op) {
+    double x, y, r;
+    if (!to_double(a, &x) || !to_double(b, &y)) return THE_NON_VALUE;
+
+    switch (op) {
+    case FLOAT_PLUS:  r = x + y; break;
+    case FLOAT_MINUS: r = x - y; break;
+    case FLOAT_TIMES: r = x * y; break;
+    default:
+        if (y == 0.0) return THE_NON_VALUE;
+        r = x / y;
+        break;
+    }
+    // Erlang has no infinities or NaN
+    if (!isfinite(r)) return THE_NON_VALUE;
+
+    Eterm *hp = heap_alloc(heap, FLOAT_SIZE);
+    return make_float(&hp, r);
+}
+
+Eterm arith_plus_slow(Heap *heap, Eterm a, Eterm b) {
+    if (is_integer(a) && is_integer(b)) return big_plus(heap, a, b);
+    return float_op(heap, a, b, FLOAT_PLUS);
+}
+
+Eterm arith_minus_slow(Heap *heap, Eterm a, Eterm b) {
+    if (is_integer(a) && is_integer(b)) return big_minus(heap, a, b);
+    return float_op(heap, a, b, FLOAT_MINUS);
+}
+
+Eterm arith_times_slow(Heap *heap, Eterm a, Eterm b) {
+    if (is_small(a) && is_small(b)) {
+        // the product of two smalls always fits in 128 bits
+        __int128 p = (__int128)small_value(a) * small_value(b);
+        unsigned __int128 m = p < 0 ? -(unsigned __int128)p : (unsigned __int128)p;
+        BigDigit digits[2] = { (BigDigit)m, (BigDigit)(m >> 64) };
+        return make_big(heap, digits, 2, p < 0);
+    }
+    if (is_integer(a) && is_integer(b)) return big_times(heap, a, b);
+    return float_op(heap, a, b, FLOAT_TIMES);
+}
+
+Eterm arith_fdiv(Heap *heap, Eterm a, Eterm b) {
+    return float_op(heap, a, b, FLOAT_DIV);
+}
+
+Eterm arith_int_div_slow(Heap *heap, Eterm a, Eterm b) {
+    if (!is_integer(a) || !is_integer(b)) return THE_NON_VALUE;
+    return big_div(heap, a, b);
+}
+
+Eterm arith_int_rem_slow(Heap *heap, Eterm a, Eterm b) {
+    if (!is_integer(a) || !is_integer(b)) return THE_NON_VALUE;
+    return big_rem(heap, a, b);
+}
+
+Eterm arith_band_slow(Heap *heap, Eterm a, Eterm b) {
+    if (!is_integer(a) || !is_integer(b)) return THE_NON_VALUE;
+    return big_band(heap, a, b);
+}
+
+Eterm arith_bor_slow(Heap *heap, Eterm a, Eterm b) {
+    if (!is_integer(a) || !is_integer(b)) return THE_NON_VALUE;
+    return big_bor(heap, a, b);
+}
+
+Eterm arith_bxor_slow(Heap *heap, Eterm a, Eterm b) {
+    if (!is_integer(a) || !is_integer(b)) return THE_NON_VALUE;
+    return big_bxor(heap, a, b);
+}
+
+// shift counts that do not fit a small are only fine if they shift everything out
+static Eterm shift(Heap *heap, Eterm a, Eterm b, int left) {
+    if (!is_integer(a) || !is_integer(b)) return THE_NON_VALUE;
+
+    if (is_big(b)) {
+        int towards_left = big_sign(b) ? !left : left;
+        if (towards_left) return big_cmp(a, make_small(0)) == 0 ? make_small(0) : THE_NON_VALUE;
+        return big_cmp(a, make_small(0)) < 0 ? make_small(-1) : make_small(0);
+    }
+
+    Sint64 s = small_value(b);
+    return big_bsl(heap, a, left ? s : -s);
+}
+
+Eterm arith_bsl_slow(Heap *heap, Eterm a, Eterm b) {
+    return shift(heap, a, b, 1);
+}
+
+Eterm arith_bsr_slow(Heap *heap, Eterm a, Eterm b) {
+    return shift(heap, a, b, 0);
+}
+
+Eterm arith_bnot_slow(Heap *heap, Eterm a) {
+    if (!is_integer(a)) return THE_NON_VALUE;
+    return big_bnot(heap, a);
+}
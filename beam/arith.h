@@ -0,0 +1,119 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "binary_parsing_helpers.h"
+#include "term.h"
+#include "heap.h"
+
+/*
+Arithmetic instructions (m_plus, m_minus, m_times, m_div, int_div, int_rem,
+int_band, int_bor, int_bxor, int_bsl, int_bsr, int_bnot).
+
+The inline functions handle two small integers without untagging where the
+tag survives the operation, and use the compiler overflow builtins: a 64 bit
+overflow of the tagged word is exactly a 60 bit overflow of the small
+integer. Everything else (overflow, bignums, floats, bad arguments) goes to
+the out of line *_slow functions, which promote to bignums as needed.
+
+All of them return THE_NON_VALUE on badarith.
+*/
+
+#define both_small(a, b) (((((a) ^ TAG_IMMED_SMALL) | ((b) ^ TAG_IMMED_SMALL)) & TAG_IMMED_MASK) == 0)
+
+Eterm arith_plus_slow(Heap *heap, Eterm a, Eterm b);
+Eterm arith_minus_slow(Heap *heap, Eterm a, Eterm b);
+Eterm arith_times_slow(Heap *heap, Eterm a, Eterm b);
+Eterm arith_int_div_slow(Heap *heap, Eterm a, Eterm b);
+Eterm arith_int_rem_slow(Heap *heap, Eterm a, Eterm b);
+Eterm arith_band_slow(Heap *heap, Eterm a, Eterm b);
+Eterm arith_bor_slow(Heap *heap, Eterm a, Eterm b);
+Eterm arith_bxor_slow(Heap *heap, Eterm a, Eterm b);
+Eterm arith_bsl_slow(Heap *heap, Eterm a, Eterm b);
+Eterm arith_bsr_slow(Heap *heap, Eterm a, Eterm b);
+Eterm arith_bnot_slow(Heap *heap, Eterm a);
+// '/' always produces a float
+Eterm arith_fdiv(Heap *heap, Eterm a, Eterm b);
+
+static inline Eterm arith_plus(Heap *heap, Eterm a, Eterm b) {
+    Sint64 res;
+    // (x << 4 | tag) + (y << 4) == (x + y) << 4 | tag
+    if (both_small(a, b) && !__builtin_add_overflow((Sint64)a, (Sint64)(b - TAG_IMMED_SMALL), &res)) {
+        return (Eterm)res;
+    }
+    return arith_plus_slow(heap, a, b);
+}
+
+static inline Eterm arith_minus(Heap *heap, Eterm a, Eterm b) {
+    Sint64 res;
+    if (both_small(a, b) && !__builtin_sub_overflow((Sint64)a, (Sint64)(b - TAG_IMMED_SMALL), &res)) {
+        return (Eterm)res;
+    }
+    return arith_minus_slow(heap, a, b);
+}
+
+static inline Eterm arith_times(Heap *heap, Eterm a, Eterm b) {
+    Sint64 res;
+    // x * (y << 4) == (x * y) << 4
+    if (both_small(a, b) && !__builtin_mul_overflow(small_value(a), (Sint64)(b - TAG_IMMED_SMALL), &res)) {
+        return (Eterm)res | TAG_IMMED_SMALL;
+    }
+    return arith_times_slow(heap, a, b);
+}
+
+static inline Eterm arith_int_div(Heap *heap, Eterm a, Eterm b) {
+    // MIN_SMALL div -1 is the only quotient of two smalls that is not a small
+    if (both_small(a, b) && b != make_small(0) && b != make_small(-1)) {
+        return make_small(small_value(a) / small_value(b));
+    }
+    return arith_int_div_slow(heap, a, b);
+}
+
+static inline Eterm arith_int_rem(Heap *heap, Eterm a, Eterm b) {
+    if (both_small(a, b) && b != make_small(0)) {
+        return make_small(small_value(a) % small_value(b));
+    }
+    return arith_int_rem_slow(heap, a, b);
+}
+
+static inline Eterm arith_band(Heap *heap, Eterm a, Eterm b) {
+    if (both_small(a, b)) return a & b;
+    return arith_band_slow(heap, a, b);
+}
+
+static inline Eterm arith_bor(Heap *heap, Eterm a, Eterm b) {
+    if (both_small(a, b)) return a | b;
+    return arith_bor_slow(heap, a, b);
+}
+
+static inline Eterm arith_bxor(Heap *heap, Eterm a, Eterm b) {
+    if (both_small(a, b)) return (a ^ b) | TAG_IMMED_SMALL;
+    return arith_bxor_slow(heap, a, b);
+}
+
+static inline Eterm arith_bsl(Heap *heap, Eterm a, Eterm b) {
+    if (both_small(a, b)) {
+        Sint64 x = small_value(a);
+        Sint64 s = small_value(b);
+        // shifting left and back must give x again, and the result must be a small
+        if (s >= 0 && s < SMALL_BITS) {
+            Sint64 res = (Sint64)((Uint64)x << s);
+            if ((res >> s) == x && IS_SSMALL(res)) return make_small(res);
+        }
+    }
+    return arith_bsl_slow(heap, a, b);
+}
+
+static inline Eterm arith_bsr(Heap *heap, Eterm a, Eterm b) {
+    if (both_small(a, b) && small_value(b) >= 0) {
+        Sint64 s = small_value(b);
+        return make_small(small_value(a) >> (s < 63 ? s : 63));
+    }
+    return arith_bsr_slow(heap, a, b);
+}
+
+static inline Eterm arith_bnot(Heap *heap, Eterm a) {
+    // ~(x << 4 | tag) == ~x << 4 | ~tag, flip the tag bits back
+    if (is_small(a)) return ~a ^ TAG_IMMED_MASK;
+    return arith_bnot_slow(heap, a);
+}
@@ -0,0 +1,163 @@
+#include <pthread.h>
+#include "atom.h"
+
+typedef struct {
+    char *name;
+    usize len;
+    Uint32 hash;
+} AtomEntry;
+
+/*
+entries: id -> name, grows by doubling
+slots:   open addressing hash index, holds id + 1 (0 = empty)
+Readers take the read lock, inserts the write lock. Names are allocated
+separately so a pointer handed out survives a resize of entries.
+*/
+static pthread_rwlock_t atom_lock = PTHREAD_RWLOCK_INITIALIZER;
+static AtomEntry *entries;
+static Uint32 entry_count;
+static Uint32 entry_capacity;
+static Uint32 *slots;
+static Uint32 slot_count;
+
+// FNV-1a
+static Uint32 atom_hash(const char *name, usize len) {
+    Uint32 h = 2166136261u;
+    for (usize i = 0; i < len; i++) {
+        h ^= (byte)name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int find_slot(const char *name, usize len, Uint32 hash, Uint32 *slot_out) {
+    if (slot_count == 0) return 0;
+    Uint32 mask = slot_count - 1;
+    for (Uint32 s = hash & mask;; s = (s + 1) & mask) {
+        Uint32 v = slots[s];
+        if (v == 0) {
+            *slot_out = s;
+            return 0;
+        }
+        AtomEntry *e = &entries[v - 1];
+        if (e->hash == hash && e->len == len && memcmp(e->name, name, len) == 0) {
+            *slot_out = s;
+            return 1;
+        }
+    }
+}
+
+static void grow_slots(void) {
+    Uint32 new_count = slot_count ? slot_count * 2 : 1024;
+    Uint32 *new_slots = calloc(new_count, sizeof(Uint32));
+    if (!new_slots) {
+        perror("calloc failed");
+        exit(1);
+    }
+    for (Uint32 id = 0; id < entry_count; id++) {
+        Uint32 s = entries[id].hash & (new_count - 1);
+        while (new_slots[s] != 0) s = (s + 1) & (new_count - 1);
+        new_slots[s] = id + 1;
+    }
+    free(slots);
+    slots = new_slots;
+    slot_count = new_count;
+}
+
+int atom_lookup(const char *name, usize len, Uint32 *id_out) {
+    Uint32 hash = atom_hash(name, len);
+    Uint32 s;
+    int found;
+
+    pthread_rwlock_rdlock(&atom_lock);
+    found = find_slot(name, len, hash, &s);
+    if (found) *id_out = slots[s] - 1;
+    pthread_rwlock_unlock(&atom_lock);
+    return found;
+}
+
+Uint32 atom_put(const char *name, usize len) {
+    Uint32 id;
+    if (atom_lookup(name, len, &id)) return id;
+
+    Uint32 hash = atom_hash(name, len);
+    Uint32 s = 0;
+
+    pthread_rwlock_wrlock(&atom_lock);
+    // somebody may have inserted it between the two locks
+    if (find_slot(name, len, hash, &s)) {
+        id = slots[s] - 1;
+        pthread_rwlock_unlock(&atom_lock);
+        return id;
+    }
+
+    // keep the load factor below 1/2
+    if ((entry_count + 1) * 2 > slot_count) {
+        grow_slots();
+        find_slot(name, len, hash, &s);
+    }
+
+    if (entry_count == entry_capacity) {
+        entry_capacity = entry_capacity ? entry_capacity * 2 : 512;
+        entries = realloc(entries, sizeof(AtomEntry) * entry_capacity);
+        if (!entries) {
+            perror("realloc failed");
+            exit(1);
+        }
+    }
+
+    AtomEntry *e = &entries[entry_count];
+    e->name = malloc(len + 1);
+    if (!e->name) {
+        perror("malloc failed");
+        exit(1);
+    }
+    memcpy(e->name, name, len);
+    e->name[len] = '\0';
+    e->len = len;
+    e->hash = hash;
+
+    id = entry_count++;
+    slots[s] = id + 1;
+    pthread_rwlock_unlock(&atom_lock);
+    return id;
+}
+
+const char *atom_name(Uint32 id, usize *len_out) {
+    const char *name = NULL;
+    usize len = 0;
+
+    pthread_rwlock_rdlock(&atom_lock);
+    if (id < entry_count) {
+        name = entries[id].name;
+        len = entries[id].len;
+    }
+    pthread_rwlock_unlock(&atom_lock);
+
+    if (len_out) *len_out = len;
+    return name;
+}
+
+Uint32 atom_count(void) {
+    pthread_rwlock_rdlock(&atom_lock);
+    Uint32 n = entry_count;
+    pthread_rwlock_unlock(&atom_lock);
+    return n;
+}
+
+int atom_cmp(Uint32 a, Uint32 b) {
+    if (a == b) return 0;
+
+    usize alen, blen;
+    const char *an = atom_name(a, &alen);
+    const char *bn = atom_name(b, &blen);
+    usize n = alen < blen ? alen : blen;
+
+    int c = memcmp(an, bn, n);
+    if (c != 0) return c;
+    return alen < blen ? -1 : (alen > blen ? 1 : 0);
+}
+
+Eterm am(const char *name) {
+    return make_atom(atom_put(name, strlen(name)));
+}
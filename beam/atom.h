@@ -0,0 +1,30 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "binary_parsing_helpers.h"
+#include "term.h"
+
+/*
+Global atom table shared by all loaded modules.
+
+Module atom tables are indexed per module; terms always carry the global id
+so they can be compared and stored (e.g. in ETS tables) without knowing which
+module created them. Ids are never reused and names never move, so pointers
+returned by atom_name() stay valid for the lifetime of the runtime.
+*/
+
+// returns the global id of the atom, inserting it if it is new
+Uint32 atom_put(const char *name, usize len);
+// returns 1 and stores the id if the atom exists, 0 otherwise
+int atom_lookup(const char *name, usize len, Uint32 *id_out);
+// returns the name of the atom and stores its length in len_out (may be NULL)
+const char *atom_name(Uint32 id, usize *len_out);
+Uint32 atom_count(void);
+
+// compares two atoms by name (the standard term order for atoms)
+int atom_cmp(Uint32 a, Uint32 b);
+
+// convenience: atom term for a C string
+Eterm am(const char *name);
@@ -0,0 +1,104 @@
+/*
+Arithmetic benchmark.
+
+1. Small integer fast paths of the arithmetic instructions.
+2. Small integer overflow promoting to a bignum.
+3. Bignum multiplication for growing operand sizes (Karatsuba kicks in at
+   KARATSUBA_THRESHOLD digits) and division of the product.
+
+usage: arith_bench [iterations]
+*/
+#include <time.h>
+#include "arith.h"
+#include "big.h"
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static Uint64 next_rand(Uint64 *s) {
+    Uint64 x = *s;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *s = x;
+    return x;
+}
+
+static volatile Eterm sink;
+
+static void report(const char *what, usize n, double seconds) {
+    printf("%-36s %8.2f ns/op\n", what, seconds * 1e9 / n);
+}
+
+#define SMALL_LOOP(name, expr)                                  \
+    do {                                                        \
+        Eterm acc = make_small(1);                              \
+        double start = now_seconds();                           \
+        for (usize i = 0; i < n; i++) {                         \
+            Eterm x = make_small((Sint64)(i & 0xffff) + 1);     \
+            acc = (expr);                                       \
+        }                                                       \
+        report(name, n, now_seconds() - start);                 \
+        sink = acc;                                             \
+    } while (0)
+
+static Eterm random_big(Heap *heap, usize digits, Uint64 *seed) {
+    BigDigit *d = malloc(sizeof(BigDigit) * digits);
+    for (usize i = 0; i < digits; i++) d[i] = next_rand(seed);
+    d[digits - 1] |= 1;
+    Eterm t = make_big(heap, d, digits, 0);
+    free(d);
+    return t;
+}
+
+int main(int argc, char **argv) {
+    usize n = argc > 1 ? (usize)strtoull(argv[1], NULL, 10) : 50000000;
+    Heap heap;
+    heap_init(&heap, 1 << 16);
+
+    printf("small integer fast paths, %zu iterations\n", n);
+    SMALL_LOOP("m_plus", arith_plus(&heap, arith_band(&heap, acc, make_small(0xffffff)), x));
+    SMALL_LOOP("m_minus", arith_minus(&heap, arith_band(&heap, acc, make_small(0xffffff)), x));
+    SMALL_LOOP("m_times", arith_times(&heap, arith_band(&heap, acc, make_small(0xffffff)), x));
+    SMALL_LOOP("int_div", arith_int_div(&heap, arith_bor(&heap, acc, make_small(1 << 20)), x));
+    SMALL_LOOP("int_bsl + int_bsr", arith_bxor(&heap, acc, arith_bsr(&heap, arith_bsl(&heap, x, make_small(20)), make_small(3))));
+    SMALL_LOOP("int_bxor", arith_bxor(&heap, acc, x));
+
+    // every add overflows the small range and allocates a bignum
+    usize m = n / 10;
+    double start = now_seconds();
+    for (usize i = 0; i < m; i++) {
+        sink = arith_plus(&heap, make_small(MAX_SMALL), make_small((Sint64)(i & 0xff) + 1));
+        if ((i & 0xffff) == 0) heap_reset(&heap);
+    }
+    report("m_plus overflow -> bignum", m, now_seconds() - start);
+    heap_reset(&heap);
+
+    printf("\nbignum multiplication (and division of the product), 64 bit digits\n");
+    printf("%8s %14s %14s\n", "digits", "mul us/op", "div us/op");
+    Uint64 seed = 0x9e3779b97f4a7c15ULL;
+    for (usize digits = 1; digits <= 8192; digits *= 2) {
+        Eterm a = random_big(&heap, digits, &seed);
+        Eterm b = random_big(&heap, digits, &seed);
+        usize reps = digits <= 64 ? 20000 : (digits <= 1024 ? 200 : 5);
+
+        start = now_seconds();
+        Eterm p = THE_NON_VALUE;
+        for (usize i = 0; i < reps; i++) p = arith_times(&heap, a, b);
+        double mul = (now_seconds() - start) / reps;
+
+        start = now_seconds();
+        for (usize i = 0; i < reps; i++) sink = arith_int_div(&heap, p, b);
+        double div = (now_seconds() - start) / reps;
+
+        if (big_cmp(arith_int_div(&heap, p, b), a) != 0) printf("  wrong quotient for %zu digits\n", digits);
+        printf("%8zu %14.3f %14.3f\n", digits, mul * 1e6, div * 1e6);
+        heap_reset(&heap);
+    }
+
+    heap_free(&heap);
+    return 0;
+}
@@ -0,0 +1,159 @@
+/*
+ETS throughput benchmark.
+
+Every thread runs the same mix of operations on one shared table with random
+keys out of a fixed key space. Reports million operations per second for a
+read heavy and a write heavy mix, per table configuration and thread count.
+
+usage: ets_bench [max_threads] [ops_per_thread]
+*/
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "ets.h"
+#include "atom.h"
+
+#define KEY_SPACE 65536
+
+static Eterm payload;
+
+typedef struct {
+    const char *name;
+    int read_percent;       // lookups
+    int counter_percent;    // update_counter, the rest are inserts
+} Mix;
+
+typedef struct {
+    const char *name;
+    EtsType type;
+    int flags;
+} Config;
+
+typedef struct {
+    EtsTable *table;
+    const Mix *mix;
+    usize ops;
+    Uint64 seed;
+} Worker;
+
+static Uint64 next_rand(Uint64 *s) {
+    Uint64 x = *s;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *s = x;
+    return x;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// {Key, Counter, Payload}
+static Eterm make_object(Heap *heap, Sint64 key, Sint64 counter) {
+    Eterm *hp = heap_alloc(heap, 4);
+    Eterm tuple = make_tuple(&hp, 3);
+    tuple_element(tuple, 1) = make_small(key);
+    tuple_element(tuple, 2) = make_small(counter);
+    tuple_element(tuple, 3) = payload;
+    return tuple;
+}
+
+static void *run_worker(void *arg) {
+    Worker *w = arg;
+    Heap heap;
+    heap_init(&heap, 4096);
+
+    for (usize i = 0; i < w->ops; i++) {
+        Uint64 r = next_rand(&w->seed);
+        Eterm key = make_small((Sint64)(r % KEY_SPACE));
+        int op = (int)((r >> 32) % 100);
+
+        if (op < w->mix->read_percent) {
+            Eterm result;
+            ets_lookup(w->table, key, &heap, &result);
+        } else if (op < w->mix->read_percent + w->mix->counter_percent) {
+            Eterm value;
+            ets_update_counter(w->table, key, 2, make_small(1), &heap, &value);
+        } else {
+            ets_insert(w->table, make_object(&heap, small_value(key), 0));
+        }
+
+        // lookups copy onto the heap, drop the garbage now and then
+        if ((i & 1023) == 0) heap_reset(&heap);
+    }
+
+    heap_free(&heap);
+    return NULL;
+}
+
+static double run(const Config *c, const Mix *mix, int threads, usize ops) {
+    EtsTable *t = ets_new(am("bench"), c->type, 1, c->flags);
+    Heap heap;
+    heap_init(&heap, 4096);
+    for (Sint64 k = 0; k < KEY_SPACE; k++) {
+        ets_insert(t, make_object(&heap, k, 0));
+        heap_reset(&heap);
+    }
+    heap_free(&heap);
+
+    pthread_t tids[threads];
+    Worker workers[threads];
+
+    double start = now_seconds();
+    for (int i = 0; i < threads; i++) {
+        workers[i].table = t;
+        workers[i].mix = mix;
+        workers[i].ops = ops;
+        workers[i].seed = 0x9e3779b97f4a7c15ULL * (Uint64)(i + 1);
+        pthread_create(&tids[i], NULL, run_worker, &workers[i]);
+    }
+    for (int i = 0; i < threads; i++) pthread_join(tids[i], NULL);
+    double elapsed = now_seconds() - start;
+
+    ets_delete_table(t);
+    return (double)ops * threads / elapsed / 1e6;
+}
+
+int main(int argc, char **argv) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_threads = argc > 1 ? atoi(argv[1]) : (int)(cpus > 0 ? cpus : 1);
+    usize ops = argc > 2 ? (usize)strtoull(argv[2], NULL, 10) : 1000000;
+    if (max_threads < 1) max_threads = 1;
+    payload = am("payload");
+
+    const Mix mixes[] = {
+        { "read-heavy  (90% lookup, 10% update_counter)", 90, 10 },
+        { "write-heavy (10% lookup, 60% update_counter, 30% insert)", 10, 60 },
+    };
+    const Config configs[] = {
+        { "set", ETS_SET, 0 },
+        { "set read_concurrency", ETS_SET, ETS_READ_CONCURRENCY },
+        { "set write_concurrency", ETS_SET, ETS_WRITE_CONCURRENCY },
+        { "set read+write_concurrency", ETS_SET, ETS_READ_CONCURRENCY | ETS_WRITE_CONCURRENCY },
+        { "ordered_set", ETS_ORDERED_SET, 0 },
+        { "ordered_set read_concurrency", ETS_ORDERED_SET, ETS_READ_CONCURRENCY },
+        { "ordered_set write_concurrency", ETS_ORDERED_SET, ETS_WRITE_CONCURRENCY },
+        { "ordered_set read+write_concurrency", ETS_ORDERED_SET, ETS_READ_CONCURRENCY | ETS_WRITE_CONCURRENCY },
+    };
+
+    printf("%zu ops per thread, %d keys\n", ops, KEY_SPACE);
+    for (usize m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++) {
+        printf("\n%s, Mops/s\n", mixes[m].name);
+        printf("%-36s", "table");
+        for (int n = 1; n <= max_threads; n *= 2) printf("%10d", n);
+        printf("\n");
+
+        for (usize c = 0; c < sizeof(configs) / sizeof(configs[0]); c++) {
+            printf("%-36s", configs[c].name);
+            for (int n = 1; n <= max_threads; n *= 2) {
+                printf("%10.2f", run(&configs[c], &mixes[m], n, ops));
+                fflush(stdout);
+            }
+            printf("\n");
+        }
+    }
+    return 0;
+}
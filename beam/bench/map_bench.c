@@ -0,0 +1,168 @@
+/*
+Map benchmark.
+
+Struct field access: a 10 field struct (flatmap with atom keys) read with
+map_get and get_map_elements, and updated with put_map_exact, which shares
+the key tuple and only copies the values.
+
+Large map updates: HAMTs of growing size, random updates of existing keys
+and inserts of new keys. Updates run in batches on a scratch heap that is
+reset after each batch, every batch starting again from the base map.
+
+usage: map_bench [ops]
+*/
+#include <time.h>
+#include "map.h"
+#include "atom.h"
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static Uint64 next_rand(Uint64 *s) {
+    Uint64 x = *s;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *s = x;
+    return x;
+}
+
+static volatile Eterm sink;
+
+static void report(const char *what, usize n, double seconds) {
+    printf("%-40s %10zu ops %8.1f ns/op %8.2f Mops/s\n", what, n, seconds * 1e9 / n, n / seconds / 1e6);
+}
+
+#define STRUCT_FIELDS 10
+#define BATCH 10000
+
+static void struct_bench(usize n) {
+    static const char *fields[STRUCT_FIELDS] = {
+        "__struct__", "id", "name", "email", "age", "admin", "inserted_at", "updated_at", "team", "score"
+    };
+    Heap heap, scratch;
+    heap_init(&heap, 0);
+    heap_init(&scratch, 1 << 16);
+
+    Eterm kvs[2 * STRUCT_FIELDS];
+    for (int i = 0; i < STRUCT_FIELDS; i++) {
+        kvs[2 * i] = am(fields[i]);
+        kvs[2 * i + 1] = make_small(i);
+    }
+    Eterm user = map_from_pairs(&heap, kvs, STRUCT_FIELDS);
+
+    // the loader sorts constant key lists, do the same here
+    Eterm keys[3] = { am("name"), am("age"), am("score") };
+    Eterm sorted[6] = { keys[0], NIL, keys[1], NIL, keys[2], NIL };
+    map_sort_pairs(sorted, 3, 2);
+    Eterm sorted_keys[3] = { sorted[0], sorted[2], sorted[4] };
+    Eterm vals[3];
+
+    printf("struct with %d fields, %zu ops\n", STRUCT_FIELDS, n);
+    double start = now_seconds();
+    for (usize i = 0; i < n; i++) sink = map_get(user, keys[i % 3]);
+    report("map_get (one field)", n, now_seconds() - start);
+
+    start = now_seconds();
+    for (usize i = 0; i < n; i++) {
+        map_get_elements(user, sorted_keys, 3, vals);
+        sink = vals[2];
+    }
+    report("get_map_elements 3 keys (sorted)", n, now_seconds() - start);
+
+    start = now_seconds();
+    for (usize i = 0; i < n; i++) {
+        map_get_elements(user, keys, 3, vals);
+        sink = vals[2];
+    }
+    report("get_map_elements 3 keys (unsorted)", n, now_seconds() - start);
+
+    Eterm update[4] = { am("age"), make_small(0), am("score"), make_small(0) };
+    map_sort_pairs(update, 2, 2);
+    Eterm m = user;
+    start = now_seconds();
+    for (usize i = 0; i < n; i++) {
+        update[1] = make_small(i);
+        m = map_put_pairs(&scratch, m, update, 2, 1);
+        if (i % BATCH == BATCH - 1) {
+            heap_reset(&scratch);
+            m = user;
+        }
+    }
+    report("put_map_exact 2 keys", n, now_seconds() - start);
+    sink = m;
+    heap_reset(&scratch);
+    m = map_put_pairs(&scratch, user, update, 2, 1);
+    printf("  %zu words per update, keys shared: %s\n", heap_used(&scratch),
+           flatmap_keys(m) == flatmap_keys(user) ? "yes" : "no");
+
+    heap_free(&scratch);
+    heap_free(&heap);
+}
+
+static void large_map_bench(usize size, usize n) {
+    Heap heap, scratch;
+    heap_init(&heap, 0);
+    heap_init(&scratch, 1 << 16);
+    Uint64 seed = 0x9e3779b97f4a7c15ULL + size;
+
+    Eterm *kvs = malloc(2 * size * sizeof(Eterm));
+    if (!kvs) {
+        perror("malloc failed");
+        exit(1);
+    }
+    for (usize i = 0; i < size; i++) {
+        kvs[2 * i] = make_small(i);
+        kvs[2 * i + 1] = make_small(i);
+    }
+    double start = now_seconds();
+    Eterm base = map_from_pairs(&heap, kvs, size);
+    double build = now_seconds() - start;
+    free(kvs);
+
+    printf("\nmap with %zu keys (built in %.1f ms, %zu words)\n", size, build * 1e3, heap_used(&heap));
+
+    start = now_seconds();
+    for (usize i = 0; i < n; i++) sink = map_get(base, make_small(next_rand(&seed) % size));
+    report("  get", n, now_seconds() - start);
+
+    Eterm m = base;
+    start = now_seconds();
+    for (usize i = 0; i < n; i++) {
+        m = map_put(&scratch, m, make_small(next_rand(&seed) % size), make_small(i));
+        if (i % BATCH == BATCH - 1) {
+            heap_reset(&scratch);
+            m = base;
+        }
+    }
+    report("  update existing key", n, now_seconds() - start);
+    heap_reset(&scratch);
+
+    m = base;
+    start = now_seconds();
+    for (usize i = 0; i < n; i++) {
+        m = map_put(&scratch, m, make_small(size + i % BATCH), make_small(i));
+        if (i % BATCH == BATCH - 1) {
+            heap_reset(&scratch);
+            m = base;
+        }
+    }
+    report("  insert new key", n, now_seconds() - start);
+    sink = m;
+
+    heap_free(&scratch);
+    heap_free(&heap);
+}
+
+int main(int argc, char **argv) {
+    usize n = argc > 1 ? (usize)strtoull(argv[1], NULL, 10) : 2000000;
+
+    struct_bench(n * 10);
+    for (usize size = 100; size <= 1000000; size *= 10) {
+        large_map_bench(size, n);
+    }
+    return 0;
+}
@@ -0,0 +1,251 @@
+/*
+Spawn / exit throughput benchmark.
+
+Every thread is a scheduler that keeps a window of live processes: it spawns
+a process, builds a small term on its heap, looks up a random live pid (the
+lookup a send does) and exits the oldest one. Reports million spawn+exit
+pairs per second per thread count for:
+
+pooled:     spawn and exit on the same scheduler, served by its pool
+handoff:    processes exit on the next scheduler (passed through a ring),
+            so PCBs flow between pools over the global free stack
+malloc:     the same work with a fresh PCB, heap and stack per process and
+            no table, for comparison
+
+Exited pids must not resolve any more; every stale pid is checked.
+
+usage: process_bench [max_threads] [spawns_per_thread]
+*/
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include "scheduler.h"
+
+#define LIVE 64
+#define RING 1024
+
+typedef struct {
+    _Atomic usize head;     // written by the consumer
+    _Atomic usize tail;     // written by the producer
+    Process *items[RING];
+} Ring;
+
+typedef struct {
+    int id;
+    usize spawns;
+    Ring *out;              // handoff: processes for the next scheduler
+    Ring *in;
+    usize stale;            // exited pids that still resolved
+    usize found;            // lookups that found a live process
+} Worker;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// a 3-tuple on the process heap, the spawn arguments
+static void init_process(Process *p, Sint64 i) {
+    Eterm *hp = heap_alloc(&p->heap, 4);
+    Eterm tuple = make_tuple(&hp, 3);
+    tuple_element(tuple, 1) = make_small(i);
+    tuple_element(tuple, 2) = NIL;
+    tuple_element(tuple, 3) = p->pid;
+    *--p->stop = tuple;
+}
+
+static Process *spawn(Scheduler *s, Sint64 i) {
+    Process *p = process_spawn(&s->procs);
+    if (!p) {
+        fprintf(stderr, "process table full\n");
+        exit(1);
+    }
+    init_process(p, i);
+    return p;
+}
+
+// a send: find the receiver, pinned while the message would be delivered
+static void send_to(Worker *w, Eterm pid) {
+    Process *p = process_lookup(pid);
+    if (!p) return;
+    w->found++;
+    process_release(p);
+}
+
+static void exit_checked(Worker *w, Scheduler *s, Process *p) {
+    Eterm pid = p->pid;
+    process_exit(&s->procs, p);
+    Process *stale = process_lookup(pid);
+    if (stale) {
+        w->stale++;
+        process_release(stale);
+    }
+}
+
+static void *run_pooled(void *arg) {
+    Worker *w = arg;
+    Scheduler s;
+    scheduler_init(&s, w->id);
+    Process *live[LIVE];
+    Eterm pids[LIVE];
+
+    for (int i = 0; i < LIVE; i++) {
+        live[i] = spawn(&s, i);
+        pids[i] = live[i]->pid;
+    }
+    for (usize i = 0; i < w->spawns; i++) {
+        usize at = i % LIVE;
+        exit_checked(w, &s, live[at]);
+        live[at] = spawn(&s, (Sint64)i);
+        pids[at] = live[at]->pid;
+        send_to(w, pids[(i * 7 + 3) % LIVE]);
+    }
+    for (int i = 0; i < LIVE; i++) exit_checked(w, &s, live[i]);
+
+    scheduler_destroy(&s);
+    return NULL;
+}
+
+static int ring_push(Ring *r, Process *p) {
+    usize tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&r->head, memory_order_acquire) == RING) return 0;
+    r->items[tail % RING] = p;
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+static Process *ring_pop(Ring *r) {
+    usize head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    if (head == atomic_load_explicit(&r->tail, memory_order_acquire)) return NULL;
+    Process *p = r->items[head % RING];
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+    return p;
+}
+
+static void *run_handoff(void *arg) {
+    Worker *w = arg;
+    Scheduler s;
+    scheduler_init(&s, w->id);
+
+    usize spawned = 0, exited = 0;
+    Process *pending = NULL;
+    while (spawned < w->spawns || exited < w->spawns) {
+        if (!pending && spawned < w->spawns) pending = spawn(&s, (Sint64)spawned);
+        if (pending && ring_push(w->out, pending)) {
+            pending = NULL;
+            spawned++;
+        }
+        Process *p;
+        int idle = pending != NULL;
+        while ((p = ring_pop(w->in)) != NULL) {
+            send_to(w, p->pid);
+            exit_checked(w, &s, p);
+            exited++;
+            idle = 0;
+        }
+        // the next scheduler is behind, let it run when threads outnumber cores
+        if (idle) sched_yield();
+    }
+
+    scheduler_destroy(&s);
+    return NULL;
+}
+
+// what spawn and exit cost without the pool and the table
+static void *run_malloc(void *arg) {
+    Worker *w = arg;
+    Process *live[LIVE] = { 0 };
+
+    for (usize i = 0; i < w->spawns + LIVE; i++) {
+        usize at = i % LIVE;
+        if (live[at]) {
+            heap_free(&live[at]->heap);
+            free(live[at]->stack);
+            free(live[at]);
+            live[at] = NULL;
+        }
+        if (i >= w->spawns) continue;
+        Process *p = malloc(sizeof(Process));
+        Eterm *stack = malloc(PROCESS_STACK_WORDS * sizeof(Eterm));
+        if (!p || !stack) {
+            perror("malloc failed");
+            exit(1);
+        }
+        atomic_init(&p->pid, make_pid(i));
+        heap_init(&p->heap, PROCESS_HEAP_WORDS);
+        p->stack = stack;
+        p->stack_size = PROCESS_STACK_WORDS;
+        p->stop = stack + PROCESS_STACK_WORDS;
+        init_process(p, (Sint64)i);
+        live[at] = p;
+    }
+    return NULL;
+}
+
+static double run(void *(*fn)(void *), int threads, usize spawns, usize *stale) {
+    pthread_t tids[threads];
+    Worker workers[threads];
+    Ring *rings = calloc(threads, sizeof(Ring));
+    if (!rings) {
+        perror("calloc failed");
+        exit(1);
+    }
+
+    double start = now_seconds();
+    for (int i = 0; i < threads; i++) {
+        workers[i].id = i;
+        workers[i].spawns = spawns;
+        workers[i].out = &rings[i];
+        workers[i].in = &rings[(i + threads - 1) % threads];
+        workers[i].stale = 0;
+        workers[i].found = 0;
+        pthread_create(&tids[i], NULL, fn, &workers[i]);
+    }
+    for (int i = 0; i < threads; i++) pthread_join(tids[i], NULL);
+    double elapsed = now_seconds() - start;
+
+    for (int i = 0; i < threads; i++) *stale += workers[i].stale;
+    free(rings);
+    return (double)spawns * threads / elapsed / 1e6;
+}
+
+int main(int argc, char **argv) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_threads = argc > 1 ? atoi(argv[1]) : (int)(cpus > 0 ? cpus : 1);
+    usize spawns = argc > 2 ? (usize)strtoull(argv[2], NULL, 10) : 2000000;
+    if (max_threads < 1) max_threads = 1;
+
+    const struct {
+        const char *name;
+        void *(*fn)(void *);
+    } modes[] = {
+        { "pooled", run_pooled },
+        { "handoff", run_handoff },
+        { "malloc (no pool, no table)", run_malloc },
+    };
+
+    if (!process_table_init(PROCESS_TABLE_DEFAULT)) return 1;
+    printf("%zu spawns per thread, %d live per thread, Mspawn+exit/s\n", spawns, LIVE);
+    printf("%-30s", "mode");
+    for (int n = 1; n <= max_threads; n *= 2) printf("%10d", n);
+    printf("\n");
+
+    usize stale = 0;
+    for (usize m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        printf("%-30s", modes[m].name);
+        for (int n = 1; n <= max_threads; n *= 2) {
+            printf("%10.2f", run(modes[m].fn, n, spawns, &stale));
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+    process_table_destroy();
+
+    if (stale) {
+        printf("ERROR: %zu exited pids still resolved\n", stale);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,112 @@
+/*
+Timer wheel benchmark.
+
+Runs on one wheel with simulated time, like a single scheduler would:
+- insert and cancel (every receive ... after that gets its message in time)
+- insert and let expire
+- a rolling mix where each tick arms new timers and cancels most of them
+Finally checks how close an idle scheduler wakes up to a real deadline.
+
+usage: timer_bench [timers]
+*/
+#include <time.h>
+#include "timer.h"
+#include "scheduler.h"
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static Uint64 next_rand(Uint64 *s) {
+    Uint64 x = *s;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *s = x;
+    return x;
+}
+
+static usize fired_count;
+
+static void on_fire(void *arg) {
+    (void)arg;
+    fired_count++;
+}
+
+static void report(const char *what, usize n, double seconds) {
+    printf("%-34s %10zu ops %8.1f ns/op %8.2f Mops/s\n", what, n, seconds * 1e9 / n, n / seconds / 1e6);
+}
+
+int main(int argc, char **argv) {
+    usize n = argc > 1 ? (usize)strtoull(argv[1], NULL, 10) : 2000000;
+    Timer *timers = malloc(sizeof(Timer) * n);
+    TimerWheel *w = malloc(sizeof(TimerWheel));
+    if (!timers || !w) {
+        perror("malloc failed");
+        return 1;
+    }
+    Uint64 seed = 0x9e3779b97f4a7c15ULL;
+
+    for (usize i = 0; i < n; i++) timer_init(&timers[i], on_fire, NULL);
+
+    // timeouts between 1 ms and 1 hour
+    timer_wheel_init(w, 0);
+    double start = now_seconds();
+    for (usize i = 0; i < n; i++) {
+        timer_wheel_insert(w, &timers[i], 1 + next_rand(&seed) % 3600000);
+    }
+    report("insert (1 ms .. 1 h)", n, now_seconds() - start);
+
+    start = now_seconds();
+    for (usize i = 0; i < n; i++) timer_wheel_cancel(w, &timers[i]);
+    report("cancel", n, now_seconds() - start);
+
+    // timeouts between 1 ms and 10 s, all of them expire
+    timer_wheel_init(w, 0);
+    fired_count = 0;
+    start = now_seconds();
+    for (usize i = 0; i < n; i++) {
+        timer_wheel_insert(w, &timers[i], 1 + next_rand(&seed) % 10000);
+    }
+    for (Uint64 tick = 0; tick <= 10000; tick++) timer_wheel_advance(w, tick);
+    report("insert + expire (1 ms .. 10 s)", n, now_seconds() - start);
+    if (fired_count != n) printf("  expected %zu timers to fire, got %zu\n", n, fired_count);
+
+    // every tick arms 1000 timers of 5 s and cancels 95% of the previous ones
+    timer_wheel_init(w, 0);
+    usize ops = 0;
+    usize per_tick = 1000;
+    start = now_seconds();
+    for (Uint64 tick = 0; ops + per_tick <= n; tick++) {
+        for (usize i = 0; i < per_tick; i++) {
+            timer_wheel_insert(w, &timers[ops + i], tick + 5000);
+        }
+        if (ops >= per_tick) {
+            for (usize i = ops - per_tick; i < ops; i++) {
+                if (i % 20 != 0) timer_wheel_cancel(w, &timers[i]);
+            }
+        }
+        ops += per_tick;
+        timer_wheel_advance(w, tick);
+    }
+    report("gen_server mix (arm, 95% cancel)", ops, now_seconds() - start);
+    for (usize i = 0; i < ops; i++) timer_wheel_cancel(w, &timers[i]);
+
+    // idle scheduler wakes up at the next deadline
+    Scheduler s;
+    Timer t;
+    scheduler_init(&s, 0);
+    timer_init(&t, on_fire, NULL);
+    fired_count = 0;
+    Uint64 before = scheduler_now();
+    scheduler_set_timer(&s, &t, 50);
+    while (fired_count == 0) scheduler_sleep(&s);
+    printf("idle scheduler: 50 ms timer fired after %" PRIu64 " ms\n", scheduler_now() - before);
+    scheduler_destroy(&s);
+
+    free(w);
+    free(timers);
+    return 0;
+}
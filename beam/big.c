@@ -0,0 +1,602 @@
+#include "big.h"
+
+typedef unsigned __int128 DoubleDigit;
+typedef __int128 SDoubleDigit;
+
+/*
+An integer operand seen as sign + magnitude. Small integers are unpacked
+into buf so both kinds go through the same code.
+*/
+typedef struct {
+    const BigDigit *d;
+    usize n;
+    int neg;
+    BigDigit buf[1];
+} Num;
+
+static void num_of(Eterm t, Num *x) {
+    if (is_small(t)) {
+        Sint64 v = small_value(t);
+        x->neg = v < 0;
+        x->buf[0] = v < 0 ? -(Uint64)v : (Uint64)v;
+        x->d = x->buf;
+        x->n = v != 0;
+    } else {
+        x->d = big_digits(t);
+        x->n = big_size(t);
+        x->neg = big_sign(t);
+    }
+}
+
+static BigDigit *scratch(usize n) {
+    BigDigit *d = malloc(sizeof(BigDigit) * (n ? n : 1));
+    if (!d) {
+        perror("malloc failed");
+        exit(1);
+    }
+    return d;
+}
+
+static usize strip(const BigDigit *d, usize n) {
+    while (n > 0 && d[n - 1] == 0) n--;
+    return n;
+}
+
+Eterm make_big(Heap *heap, const BigDigit *digits, usize n, int negative) {
+    n = strip(digits, n);
+    if (n == 0) return make_small(0);
+
+    if (n == 1) {
+        if (!negative && digits[0] <= (Uint64)MAX_SMALL) return make_small((Sint64)digits[0]);
+        if (negative && digits[0] <= (Uint64)MAX_SMALL + 1) return make_small(-(Sint64)(digits[0] - 1) - 1);
+    }
+    if (n > BIG_MAX_DIGITS) return THE_NON_VALUE;
+
+    Eterm *hp = heap_alloc(heap, 1 + n);
+    hp[0] = make_header(n, negative ? SUBTAG_NEG_BIG : SUBTAG_POS_BIG);
+    memcpy(hp + 1, digits, n * sizeof(BigDigit));
+    return make_boxed(hp);
+}
+
+Eterm big_from_sint64(Heap *heap, Sint64 value) {
+    if (IS_SSMALL(value)) return make_small(value);
+    BigDigit d = value < 0 ? -(Uint64)value : (Uint64)value;
+    return make_big(heap, &d, 1, value < 0);
+}
+
+Eterm big_from_bytes_le(Heap *heap, const byte *data, usize len, int negative) {
+    usize n = (len + 7) / 8;
+    BigDigit *d = scratch(n);
+    memset(d, 0, n * sizeof(BigDigit));
+    for (usize i = 0; i < len; i++) {
+        d[i / 8] |= (BigDigit)data[i] << (8 * (i % 8));
+    }
+    Eterm result = make_big(heap, d, n, negative);
+    free(d);
+    return result;
+}
+
+Eterm big_from_twos_complement_be(Heap *heap, const byte *data, usize len) {
+    if (len == 0) return make_small(0);
+
+    usize n = (len + 7) / 8;
+    int negative = (data[0] & 0x80) != 0;
+    BigDigit *d = scratch(n);
+    // sign extend into the unused high bytes
+    memset(d, negative ? 0xff : 0, n * sizeof(BigDigit));
+    for (usize i = 0; i < len; i++) {
+        usize bit = 8 * (len - 1 - i);
+        d[bit / 64] &= ~((BigDigit)0xff << (bit % 64));
+        d[bit / 64] |= (BigDigit)data[i] << (bit % 64);
+    }
+    if (negative) {
+        // magnitude = ~x + 1
+        BigDigit carry = 1;
+        for (usize i = 0; i < n; i++) {
+            d[i] = ~d[i] + carry;
+            carry = carry && d[i] == 0;
+        }
+    }
+    Eterm result = make_big(heap, d, n, negative);
+    free(d);
+    return result;
+}
+
+/* -- magnitude arithmetic, digit arrays least significant first -- */
+
+static int mag_cmp(const BigDigit *a, usize na, const BigDigit *b, usize nb) {
+    na = strip(a, na);
+    nb = strip(b, nb);
+    if (na != nb) return na < nb ? -1 : 1;
+    for (usize i = na; i > 0; i--) {
+        if (a[i - 1] != b[i - 1]) return a[i - 1] < b[i - 1] ? -1 : 1;
+    }
+    return 0;
+}
+
+// r = a + b, r has room for max(na, nb) + 1 digits, returns its length
+static usize mag_add(const BigDigit *a, usize na, const BigDigit *b, usize nb, BigDigit *r) {
+    if (na < nb) {
+        const BigDigit *t = a; a = b; b = t;
+        usize tn = na; na = nb; nb = tn;
+    }
+    BigDigit carry = 0;
+    for (usize i = 0; i < na; i++) {
+        BigDigit x = a[i];
+        BigDigit y = i < nb ? b[i] : 0;
+        BigDigit s = x + y;
+        BigDigit c1 = s < x;
+        r[i] = s + carry;
+        carry = c1 | (r[i] < s);
+    }
+    r[na] = carry;
+    return na + 1;
+}
+
+// r = a - b with a >= b, r has room for na digits
+static usize mag_sub(const BigDigit *a, usize na, const BigDigit *b, usize nb, BigDigit *r) {
+    BigDigit borrow = 0;
+    for (usize i = 0; i < na; i++) {
+        BigDigit x = a[i];
+        BigDigit y = i < nb ? b[i] : 0;
+        BigDigit d = x - y;
+        BigDigit b1 = x < y;
+        r[i] = d - borrow;
+        borrow = b1 | (d < borrow);
+    }
+    return na;
+}
+
+// x += y over the nx digits of x (ny <= nx), the sum must fit
+static void add_into(BigDigit *x, usize nx, const BigDigit *y, usize ny) {
+    BigDigit carry = 0;
+    usize i = 0;
+    for (; i < ny; i++) {
+        BigDigit s = x[i] + y[i];
+        BigDigit c1 = s < x[i];
+        x[i] = s + carry;
+        carry = c1 | (x[i] < s);
+    }
+    for (; carry && i < nx; i++) {
+        x[i] += 1;
+        carry = x[i] == 0;
+    }
+}
+
+// x -= y over the nx digits of x (ny <= nx), x must be >= y
+static void sub_from(BigDigit *x, usize nx, const BigDigit *y, usize ny) {
+    BigDigit borrow = 0;
+    usize i = 0;
+    for (; i < ny; i++) {
+        BigDigit d = x[i] - y[i];
+        BigDigit b1 = x[i] < y[i];
+        x[i] = d - borrow;
+        borrow = b1 | (d < borrow);
+    }
+    for (; borrow && i < nx; i++) {
+        borrow = x[i] == 0;
+        x[i] -= 1;
+    }
+}
+
+static void mul_school(const BigDigit *a, usize na, const BigDigit *b, usize nb, BigDigit *r) {
+    memset(r, 0, (na + nb) * sizeof(BigDigit));
+    for (usize i = 0; i < na; i++) {
+        BigDigit carry = 0;
+        for (usize j = 0; j < nb; j++) {
+            DoubleDigit t = (DoubleDigit)a[i] * b[j] + r[i + j] + carry;
+            r[i + j] = (BigDigit)t;
+            carry = (BigDigit)(t >> BIG_DIGIT_BITS);
+        }
+        r[i + nb] = carry;
+    }
+}
+
+static void mag_mul(const BigDigit *a, usize na, const BigDigit *b, usize nb, BigDigit *r);
+
+/*
+Karatsuba with na >= nb > na / 2. With a = a1*B^m + a0 and b = b1*B^m + b0:
+a*b = z2*B^2m + (z1 - z2 - z0)*B^m + z0
+where z0 = a0*b0, z2 = a1*b1, z1 = (a0 + a1)*(b0 + b1)
+*/
+static void mul_karatsuba(const BigDigit *a, usize na, const BigDigit *b, usize nb, BigDigit *r) {
+    usize m = na / 2;
+    usize na1 = na - m;
+    usize nb1 = nb - m;
+
+    // z0 and z2 go straight into their place in r
+    mag_mul(a, m, b, m, r);
+    mag_mul(a + m, na1, b + m, nb1, r + 2 * m);
+
+    usize nsa = (na1 > m ? na1 : m) + 1;
+    usize nsb = (nb1 > m ? nb1 : m) + 1;
+    BigDigit *sa = scratch(nsa + nsb + nsa + nsb);
+    BigDigit *sb = sa + nsa;
+    BigDigit *z1 = sb + nsb;
+
+    mag_add(a, m, a + m, na1, sa);
+    mag_add(b, m, b + m, nb1, sb);
+    mag_mul(sa, nsa, sb, nsb, z1);
+
+    usize nz1 = nsa + nsb;
+    sub_from(z1, nz1, r, 2 * m);
+    sub_from(z1, nz1, r + 2 * m, na1 + nb1);
+    add_into(r + m, na + nb - m, z1, strip(z1, nz1));
+
+    free(sa);
+}
+
+// r = a * b, r has room for na + nb digits
+static void mag_mul(const BigDigit *a, usize na, const BigDigit *b, usize nb, BigDigit *r) {
+    if (na < nb) {
+        const BigDigit *t = a; a = b; b = t;
+        usize tn = na; na = nb; nb = tn;
+    }
+
+    if (nb < KARATSUBA_THRESHOLD) {
+        mul_school(a, na, b, nb, r);
+        return;
+    }
+
+    if (na < 2 * nb) {
+        mul_karatsuba(a, na, b, nb, r);
+        return;
+    }
+
+    // unbalanced: multiply b by nb digit slices of a
+    BigDigit *tmp = scratch(2 * nb);
+    memset(r, 0, (na + nb) * sizeof(BigDigit));
+    for (usize off = 0; off < na; off += nb) {
+        usize len = na - off < nb ? na - off : nb;
+        mag_mul(a + off, len, b, nb, tmp);
+        add_into(r + off, na + nb - off, tmp, len + nb);
+    }
+    free(tmp);
+}
+
+/*
+q = u / v, r = u % v (Knuth, algorithm D). q has room for nu - nv + 1 digits,
+r for nv digits. v must be normalized and not zero.
+*/
+static void mag_divrem(const BigDigit *u, usize nu, const BigDigit *v, usize nv, BigDigit *q, BigDigit *r) {
+    nu = strip(u, nu);
+
+    if (nu < nv) {
+        if (q) memset(q, 0, sizeof(BigDigit));
+        if (r) {
+            memset(r, 0, nv * sizeof(BigDigit));
+            memcpy(r, u, nu * sizeof(BigDigit));
+        }
+        return;
+    }
+
+    if (nv == 1) {
+        BigDigit rem = 0;
+        for (usize i = nu; i > 0; i--) {
+            DoubleDigit num = ((DoubleDigit)rem << BIG_DIGIT_BITS) | u[i - 1];
+            if (q) q[i - 1] = (BigDigit)(num / v[0]);
+            rem = (BigDigit)(num % v[0]);
+        }
+        if (r) r[0] = rem;
+        return;
+    }
+
+    // shift so the top digit of v has its high bit set
+    int s = __builtin_clzll(v[nv - 1]);
+    BigDigit *vn = scratch(nv + nu + 1);
+    BigDigit *un = vn + nv;
+
+    for (usize i = nv - 1; i > 0; i--) {
+        vn[i] = (v[i] << s) | (s ? v[i - 1] >> (BIG_DIGIT_BITS - s) : 0);
+    }
+    vn[0] = v[0] << s;
+    un[nu] = s ? u[nu - 1] >> (BIG_DIGIT_BITS - s) : 0;
+    for (usize i = nu - 1; i > 0; i--) {
+        un[i] = (u[i] << s) | (s ? u[i - 1] >> (BIG_DIGIT_BITS - s) : 0);
+    }
+    un[0] = u[0] << s;
+
+    const DoubleDigit base = (DoubleDigit)1 << BIG_DIGIT_BITS;
+
+    for (usize jj = nu - nv + 1; jj > 0; jj--) {
+        usize j = jj - 1;
+        DoubleDigit num = ((DoubleDigit)un[j + nv] << BIG_DIGIT_BITS) | un[j + nv - 1];
+        DoubleDigit qhat = num / vn[nv - 1];
+        DoubleDigit rhat = num % vn[nv - 1];
+
+        while (qhat >= base || qhat * vn[nv - 2] > ((rhat << BIG_DIGIT_BITS) | un[j + nv - 2])) {
+            qhat--;
+            rhat += vn[nv - 1];
+            if (rhat >= base) break;
+        }
+
+        // un[j .. j+nv] -= qhat * vn
+        SDoubleDigit k = 0;
+        SDoubleDigit t;
+        for (usize i = 0; i < nv; i++) {
+            DoubleDigit p = qhat * vn[i];
+            t = (SDoubleDigit)un[i + j] - k - (SDoubleDigit)(BigDigit)p;
+            un[i + j] = (BigDigit)t;
+            k = (SDoubleDigit)(p >> BIG_DIGIT_BITS) - (t >> BIG_DIGIT_BITS);
+        }
+        t = (SDoubleDigit)un[j + nv] - k;
+        un[j + nv] = (BigDigit)t;
+
+        if (t < 0) {
+            // qhat was one too large, add v back
+            qhat--;
+            DoubleDigit c = 0;
+            for (usize i = 0; i < nv; i++) {
+                DoubleDigit sum = (DoubleDigit)un[i + j] + vn[i] + c;
+                un[i + j] = (BigDigit)sum;
+                c = sum >> BIG_DIGIT_BITS;
+            }
+            un[j + nv] += (BigDigit)c;
+        }
+        if (q) q[j] = (BigDigit)qhat;
+    }
+
+    if (r) {
+        for (usize i = 0; i < nv; i++) {
+            r[i] = (un[i] >> s) | (s ? un[i + 1] << (BIG_DIGIT_BITS - s) : 0);
+        }
+    }
+    free(vn);
+}
+
+/* -- integer operations -- */
+
+static Eterm signed_add(Heap *heap, const Num *a, const Num *b, int b_neg) {
+    usize n = (a->n > b->n ? a->n : b->n) + 1;
+    BigDigit *r = scratch(n);
+    Eterm result;
+
+    if (a->neg == b_neg) {
+        usize nr = mag_add(a->d, a->n, b->d, b->n, r);
+        result = make_big(heap, r, nr, a->neg);
+    } else if (mag_cmp(a->d, a->n, b->d, b->n) >= 0) {
+        usize nr = mag_sub(a->d, a->n, b->d, b->n, r);
+        result = make_big(heap, r, nr, a->neg);
+    } else {
+        usize nr = mag_sub(b->d, b->n, a->d, a->n, r);
+        result = make_big(heap, r, nr, b_neg);
+    }
+    free(r);
+    return result;
+}
+
+Eterm big_plus(Heap *heap, Eterm a, Eterm b) {
+    Num x, y;
+    num_of(a, &x);
+    num_of(b, &y);
+    return signed_add(heap, &x, &y, y.neg);
+}
+
+Eterm big_minus(Heap *heap, Eterm a, Eterm b) {
+    Num x, y;
+    num_of(a, &x);
+    num_of(b, &y);
+    return signed_add(heap, &x, &y, y.n ? !y.neg : 0);
+}
+
+Eterm big_times(Heap *heap, Eterm a, Eterm b) {
+    Num x, y;
+    num_of(a, &x);
+    num_of(b, &y);
+    if (x.n == 0 || y.n == 0) return make_small(0);
+    if (x.n + y.n > BIG_MAX_DIGITS) return THE_NON_VALUE;
+
+    BigDigit *r = scratch(x.n + y.n);
+    mag_mul(x.d, x.n, y.d, y.n, r);
+    Eterm result = make_big(heap, r, x.n + y.n, x.neg != y.neg);
+    free(r);
+    return result;
+}
+
+static Eterm divrem(Heap *heap, Eterm a, Eterm b, int want_rem) {
+    Num x, y;
+    num_of(a, &x);
+    num_of(b, &y);
+    if (y.n == 0) return THE_NON_VALUE;
+
+    if (x.n < y.n) return want_rem ? a : make_small(0);
+
+    BigDigit *q = scratch(x.n - y.n + 1 + y.n);
+    BigDigit *r = q + x.n - y.n + 1;
+    mag_divrem(x.d, x.n, y.d, y.n, q, r);
+
+    Eterm result = want_rem
+        ? make_big(heap, r, y.n, x.neg)
+        : make_big(heap, q, x.n - y.n + 1, x.neg != y.neg);
+    free(q);
+    return result;
+}
+
+Eterm big_div(Heap *heap, Eterm a, Eterm b) {
+    return divrem(heap, a, b, 0);
+}
+
+Eterm big_rem(Heap *heap, Eterm a, Eterm b) {
+    return divrem(heap, a, b, 1);
+}
+
+/* -- bitwise operations on two's complement -- */
+
+static void to_twos(const Num *x, BigDigit *out, usize n) {
+    memset(out, 0, n * sizeof(BigDigit));
+    memcpy(out, x->d, x->n * sizeof(BigDigit));
+    if (x->neg) {
+        BigDigit carry = 1;
+        for (usize i = 0; i < n; i++) {
+            out[i] = ~out[i] + carry;
+            carry = carry && out[i] == 0;
+        }
+    }
+}
+
+static Eterm from_twos(Heap *heap, BigDigit *d, usize n) {
+    int negative = (d[n - 1] >> (BIG_DIGIT_BITS - 1)) != 0;
+    if (negative) {
+        BigDigit carry = 1;
+        for (usize i = 0; i < n; i++) {
+            d[i] = ~d[i] + carry;
+            carry = carry && d[i] == 0;
+        }
+    }
+    return make_big(heap, d, n, negative);
+}
+
+enum { BIT_AND, BIT_OR, BIT_XOR };
+
+static Eterm bitwise(Heap *heap, Eterm a, Eterm b, int op) {
+    Num x, y;
+    num_of(a, &x);
+    num_of(b, &y);
+
+    // one extra digit so the sign bit never collides with the magnitude
+    usize n = (x.n > y.n ? x.n : y.n) + 1;
+    BigDigit *tx = scratch(2 * n);
+    BigDigit *ty = tx + n;
+    to_twos(&x, tx, n);
+    to_twos(&y, ty, n);
+
+    for (usize i = 0; i < n; i++) {
+        switch (op) {
+        case BIT_AND: tx[i] &= ty[i]; break;
+        case BIT_OR:  tx[i] |= ty[i]; break;
+        case BIT_XOR: tx[i] ^= ty[i]; break;
+        }
+    }
+    Eterm result = from_twos(heap, tx, n);
+    free(tx);
+    return result;
+}
+
+Eterm big_band(Heap *heap, Eterm a, Eterm b) {
+    return bitwise(heap, a, b, BIT_AND);
+}
+
+Eterm big_bor(Heap *heap, Eterm a, Eterm b) {
+    return bitwise(heap, a, b, BIT_OR);
+}
+
+Eterm big_bxor(Heap *heap, Eterm a, Eterm b) {
+    return bitwise(heap, a, b, BIT_XOR);
+}
+
+// bnot(a) = -a - 1
+Eterm big_bnot(Heap *heap, Eterm a) {
+    Num x, one;
+    num_of(a, &x);
+    num_of(make_small(1), &one);
+    x.neg = x.n ? !x.neg : 0;
+    return signed_add(heap, &x, &one, 1);
+}
+
+Eterm big_bsl(Heap *heap, Eterm a, Sint64 shift) {
+    Num x;
+    num_of(a, &x);
+    if (x.n == 0) return make_small(0);
+
+    if (shift >= 0) {
+        if ((Uint64)shift / BIG_DIGIT_BITS + x.n + 1 > BIG_MAX_DIGITS) return THE_NON_VALUE;
+
+        usize words = (usize)shift / BIG_DIGIT_BITS;
+        int bits = (int)(shift % BIG_DIGIT_BITS);
+        usize n = x.n + words + 1;
+        BigDigit *r = scratch(n);
+        memset(r, 0, n * sizeof(BigDigit));
+        for (usize i = 0; i < x.n; i++) {
+            r[i + words] |= x.d[i] << bits;
+            if (bits) r[i + words + 1] |= x.d[i] >> (BIG_DIGIT_BITS - bits);
+        }
+        Eterm result = make_big(heap, r, n, x.neg);
+        free(r);
+        return result;
+    }
+
+    // right shift, negative numbers round towards minus infinity:
+    // -m >> s == -((m - 1) >> s) - 1
+    Uint64 amount = shift == INT64_MIN ? (Uint64)INT64_MAX + 1 : (Uint64)-shift;
+    usize words = amount / BIG_DIGIT_BITS;
+    if (words >= x.n) return make_small(x.neg ? -1 : 0);
+
+    int bits = (int)(amount % BIG_DIGIT_BITS);
+    BigDigit *m = scratch(x.n);
+    memcpy(m, x.d, x.n * sizeof(BigDigit));
+    if (x.neg) sub_from(m, x.n, (const BigDigit[]){ 1 }, 1);
+
+    usize n = x.n - words;
+    BigDigit *r = scratch(n + 1);
+    for (usize i = 0; i < n; i++) {
+        r[i] = m[i + words] >> bits;
+        if (bits && i + words + 1 < x.n) r[i] |= m[i + words + 1] << (BIG_DIGIT_BITS - bits);
+    }
+    free(m);
+
+    if (x.neg) {
+        // add the 1 back and negate
+        r[n] = 0;
+        add_into(r, n + 1, (const BigDigit[]){ 1 }, 1);
+        n++;
+    }
+    Eterm result = make_big(heap, r, n, x.neg);
+    free(r);
+    return result;
+}
+
+/* -- comparison and conversion -- */
+
+int big_cmp(Eterm a, Eterm b) {
+    Num x, y;
+    num_of(a, &x);
+    num_of(b, &y);
+
+    if (x.neg != y.neg) return x.neg ? -1 : 1;
+    int c = mag_cmp(x.d, x.n, y.d, y.n);
+    return x.neg ? -c : c;
+}
+
+double big_to_double(Eterm t) {
+    Num x;
+    num_of(t, &x);
+
+    double d = 0.0;
+    for (usize i = x.n; i > 0; i--) {
+        d = d * 18446744073709551616.0 + (double)x.d[i - 1];
+    }
+    return x.neg ? -d : d;
+}
+
+// prints in decimal by repeatedly dividing by 10^19
+void big_print(FILE *out, Eterm t) {
+    Num x;
+    num_of(t, &x);
+    if (x.n == 0) {
+        fprintf(out, "0");
+        return;
+    }
+
+    const BigDigit chunk = 10000000000000000000ULL;
+    BigDigit *m = scratch(x.n);
+    // every chunk holds at least 63 bits of the number
+    BigDigit *parts = scratch(x.n * 64 / 63 + 2);
+    usize nparts = 0;
+    usize n = x.n;
+
+    memcpy(m, x.d, n * sizeof(BigDigit));
+    while (n > 0) {
+        BigDigit rem;
+        mag_divrem(m, n, &chunk, 1, m, &rem);
+        parts[nparts++] = rem;
+        n = strip(m, n);
+    }
+
+    if (x.neg) fprintf(out, "-");
+    fprintf(out, "%" PRIu64, parts[nparts - 1]);
+    for (usize i = nparts - 1; i > 0; i--) {
+        fprintf(out, "%019" PRIu64, parts[i - 1]);
+    }
+    free(parts);
+    free(m);
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "binary_parsing_helpers.h"
+#include "term.h"
+#include "heap.h"
+
+/*
+Arbitrary precision integers.
+
+A bignum is a boxed object: header (arity = number of digits, subtag gives
+the sign) followed by the magnitude as 64 bit digits, least significant
+first. Results are always normalized: no leading zero digits, and a value
+that fits in a small integer is returned as a small integer, so every
+integer has exactly one representation.
+
+The functions take small or big integers and return THE_NON_VALUE when the
+result would be unreasonably large (system_limit) or on division by zero.
+*/
+typedef Uint64 BigDigit;
+
+#define BIG_DIGIT_BITS  64
+// results larger than this many digits are refused (64 Mbit)
+#define BIG_MAX_DIGITS  (1 << 20)
+// operands shorter than this (in digits) use schoolbook multiplication
+#define KARATSUBA_THRESHOLD 32
+
+#define is_big(t)       (is_boxed(t) && (header_subtag(*boxed_val(t)) == SUBTAG_POS_BIG || \
+                                         header_subtag(*boxed_val(t)) == SUBTAG_NEG_BIG))
+#define is_integer(t)   (is_small(t) || is_big(t))
+#define is_number(t)    (is_integer(t) || is_float(t))
+#define big_size(t)     header_arity(*boxed_val(t))
+#define big_sign(t)     (header_subtag(*boxed_val(t)) == SUBTAG_NEG_BIG)
+#define big_digits(t)   ((BigDigit *)(boxed_val(t) + 1))
+
+// builds an integer from a magnitude, returns a small integer if it fits
+Eterm make_big(Heap *heap, const BigDigit *digits, usize n, int negative);
+Eterm big_from_sint64(Heap *heap, Sint64 value);
+// magnitude as little-endian bytes (external term format)
+Eterm big_from_bytes_le(Heap *heap, const byte *data, usize len, int negative);
+// big-endian two's complement bytes (compact term format in the Code chunk)
+Eterm big_from_twos_complement_be(Heap *heap, const byte *data, usize len);
+
+Eterm big_plus(Heap *heap, Eterm a, Eterm b);
+Eterm big_minus(Heap *heap, Eterm a, Eterm b);
+Eterm big_times(Heap *heap, Eterm a, Eterm b);
+// truncating division (div) and the matching remainder (rem)
+Eterm big_div(Heap *heap, Eterm a, Eterm b);
+Eterm big_rem(Heap *heap, Eterm a, Eterm b);
+
+// two's complement semantics like Erlang's band/bor/bxor/bnot
+Eterm big_band(Heap *heap, Eterm a, Eterm b);
+Eterm big_bor(Heap *heap, Eterm a, Eterm b);
+Eterm big_bxor(Heap *heap, Eterm a, Eterm b);
+Eterm big_bnot(Heap *heap, Eterm a);
+// negative shift counts shift the other way, bsr rounds towards minus infinity
+Eterm big_bsl(Heap *heap, Eterm a, Sint64 shift);
+
+// compares two integers
+int big_cmp(Eterm a, Eterm b);
+double big_to_double(Eterm t);
+void big_print(FILE *out, Eterm t);
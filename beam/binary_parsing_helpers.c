@@ -7,11 +7,12 @@ int load_file(const char *path, byte **outbuf, usize *outsize) {
     fseek(f, 0, SEEK_END);
     long sz = ftell(f);
     rewind(f);
+    if (sz < 0) { fclose(f); return -1; }
 
-    byte *buf = malloc(sz);
+    byte *buf = malloc(sz ? sz : 1);
     if (!buf) { fclose(f); return -1; }
 
-    fread(buf, 1, sz, f);
+    if (fread(buf, 1, sz, f) != (usize)sz) { free(buf); fclose(f); return -1; }
     fclose(f);
 
     *outbuf = buf;
@@ -58,7 +59,7 @@ int reader_read_bytes(Reader *r, const byte **out, usize len) {
 
 int reader_read_i32(Reader *r, Sint32 *out) {
     if (reader_remaining(r) < 4) return 0;
-    *out = (Sint32)((r->p[0] << 24) | (r->p[1] << 16) | (r->p[2] << 8) | r->p[3]);
+    *out = (Sint32)(((Uint32)r->p[0] << 24) | ((Uint32)r->p[1] << 16) | ((Uint32)r->p[2] << 8) | (Uint32)r->p[3]);
     r->p += 4;
     return 1;
 }
@@ -71,10 +72,26 @@ Uint32 align4(Uint32 n) {
 //* -- add this function near your reader helpers -- */
 /* Read a BEAM tagged integer (small/medium/extended). Returns 1 on success. */
 int read_tagged(Reader *r, int *tag_out, usize *val_out) {
+    const byte *data;
+    usize count;
+    if (!read_tagged_raw(r, tag_out, val_out, &data, &count)) return 0;
+    /* too large to fit — not expected for atom lengths */
+    if (data && count > sizeof(size_t)) return 0;
+    return 1;
+}
+
+/* Like read_tagged, but also hands out the raw value bytes of the extended form
+   so callers can handle integers that do not fit in size_t (bignums).
+   data_out is NULL for the one and two byte forms, otherwise it points at
+   count_out big-endian bytes inside the reader's buffer. val_out only holds
+   the value when it fits in size_t. */
+int read_tagged_raw(Reader *r, int *tag_out, usize *val_out, const byte **data_out, usize *count_out) {
     byte len_code;
     if (!reader_read_u8(r, &len_code)) return 0;
     int tag = len_code & 0x07;
     *tag_out = tag;
+    *data_out = NULL;
+    *count_out = 0;
 
     /* small immediate (one byte total) */
     if ((len_code & 0x08) == 0) {
@@ -101,6 +118,8 @@ int read_tagged(Reader *r, int *tag_out, usize *val_out) {
             /* read nested tagged that gives (count - 9) */
             int nested_tag;
             usize nested_val;
+            /* the nested length may not be nested again (unbounded recursion on bad input) */
+            if (reader_remaining(r) > 0 && (*r->p & 0xF8) == 0xF8) return 0;
             if (!read_tagged(r, &nested_tag, &nested_val)) return 0;
             /* we expect an unsigned here, but continue anyway */
             const int size_base = 9;
@@ -109,20 +128,18 @@ int read_tagged(Reader *r, int *tag_out, usize *val_out) {
         }
 
         if (reader_remaining(r) < count) return 0;
-        /* data are big-endian bytes forming the integer; for atom lengths
-           we expect they fit in size_t (they do in practice), so unpack */
+        /* data are big-endian bytes forming the integer */
+        const byte *data = r->p;
+        size_t acc = 0;
         if (count <= sizeof(size_t)) {
-            size_t acc = 0;
-            const byte *data = r->p;
             for (usize i = 0; i < count; ++i) {
                 acc = (acc << 8) | data[i];
             }
-            r->p += count;
-            *val_out = acc;
-            return 1;
-        } else {
-            /* too large to fit — not expected for atom lengths */
-            return 0;
         }
+        r->p += count;
+        *val_out = acc;
+        *data_out = data;
+        *count_out = count;
+        return 1;
     }
 }
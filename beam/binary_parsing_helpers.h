@@ -47,3 +47,7 @@ Uint32 align4(Uint32 n);
 //* -- add this function near your reader helpers -- */
 /* Read a BEAM tagged integer (small/medium/extended). Returns 1 on success. */
 int read_tagged(Reader *r, int *tag_out, usize *val_out); 
+
+/* Like read_tagged, but also returns the raw bytes of extended values
+   (data_out = NULL for the short forms). Used for integers wider than size_t. */
+int read_tagged_raw(Reader *r, int *tag_out, usize *val_out, const byte **data_out, usize *count_out);
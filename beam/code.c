@@ -0,0 +1,285 @@
+#include "code.h"
+#include "big.h"
+
+// reserves n operands at the end of the pool, returns the index of the first
+static usize reserve_operands(BeamCode *code, usize n) {
+    usize first = code->operand_count;
+    code->operands = realloc(code->operands, sizeof(Operand) * (first + n + 1));
+    if (!code->operands) {
+        perror("realloc failed");
+        exit(1);
+    }
+    memset(&code->operands[first], 0, sizeof(Operand) * n);
+    code->operand_count += n;
+    return first;
+}
+
+static void add_instr(BeamCode *code, int op, int arity, usize args) {
+    if ((code->instr_count & (code->instr_count - 1)) == 0) {
+        usize cap = code->instr_count ? code->instr_count * 2 : 64;
+        code->instrs = realloc(code->instrs, sizeof(Instr) * cap);
+        if (!code->instrs) {
+            perror("realloc failed");
+            exit(1);
+        }
+    }
+    Instr *in = &code->instrs[code->instr_count++];
+    in->op = (Uint16)op;
+    in->arity = (Uint16)arity;
+    in->args = (Uint32)args;
+}
+
+static int read_unsigned(Reader *r, usize *val) {
+    int tag;
+    if (!read_tagged(r, &tag, val)) return 0;
+    return tag == TAG_u;
+}
+
+/*
+Integer operands use the same length prefix as every other operand, but the
+extended form holds a big-endian two's complement number. Values of up to
+7 bytes always fit in a small and are sign extended here; anything wider
+that is not a small (8 byte values outside the 60-bit range included)
+becomes a bignum on the code heap.
+*/
+static int integer_operand(BeamCode *code, usize val, const byte *data, usize count, Operand *o) {
+    if (!data) {
+        // one and two byte forms are never negative
+        o->type = OPERAND_I;
+        o->val = (Sint64)val;
+        return 1;
+    }
+
+    if (count < sizeof(Uint64)) {
+        o->type = OPERAND_I;
+        o->val = (data[0] & 0x80) ? (Sint64)(val - ((Uint64)1 << (8 * count))) : (Sint64)val;
+        return 1;
+    }
+    if (count == sizeof(Uint64) && IS_SSMALL((Sint64)val)) {
+        o->type = OPERAND_I;
+        o->val = (Sint64)val;
+        return 1;
+    }
+
+    Eterm big = big_from_twos_complement_be(&code->heap, data, count);
+    if (!is_value(big)) return 0;
+    o->type = is_small(big) ? OPERAND_I : OPERAND_BIG;
+    o->val = is_small(big) ? small_value(big) : (Sint64)big;
+    return 1;
+}
+
+// decodes one operand into pool slot, lists only hold plain operands (in_list)
+static int read_operand(Reader *r, BeamCode *code, usize slot, int in_list) {
+    int tag;
+    usize val;
+    const byte *data;
+    usize count;
+
+    if (!read_tagged_raw(r, &tag, &val, &data, &count)) return 0;
+    // only integer literals may be wider than a machine word
+    if (tag != TAG_i && data && count > sizeof(usize)) return 0;
+
+    Operand o = { 0 };
+    o.val = (Sint64)val;
+
+    switch (tag) {
+    case TAG_u: o.type = OPERAND_U; break;
+    case TAG_i:
+        if (!integer_operand(code, val, data, count, &o)) return 0;
+        break;
+    case TAG_a: o.type = OPERAND_ATOM; break;
+    case TAG_x: o.type = OPERAND_X; break;
+    case TAG_y: o.type = OPERAND_Y; break;
+    case TAG_f: o.type = OPERAND_LABEL; break;
+    case TAG_h: o.type = OPERAND_CHAR; break;
+    case TAG_z:
+        if (in_list) return 0;
+        switch (val) {
+        case 1: {
+            // list: count, then count operands
+            usize len;
+            if (!read_unsigned(r, &len) || len > reader_remaining(r)) return 0;
+            usize first = reserve_operands(code, len);
+            for (usize i = 0; i < len; i++) {
+                if (!read_operand(r, code, first + i, 1)) return 0;
+            }
+            o.type = OPERAND_LIST;
+            o.val = (Sint64)first;
+            o.len = (Uint32)len;
+            break;
+        }
+        case 2: {
+            usize fr;
+            if (!read_unsigned(r, &fr)) return 0;
+            o.type = OPERAND_FR;
+            o.val = (Sint64)fr;
+            break;
+        }
+        case 3: {
+            // allocation list: count, then (kind, amount) pairs
+            usize len;
+            if (!read_unsigned(r, &len) || len > reader_remaining(r)) return 0;
+            usize first = reserve_operands(code, 2 * len);
+            for (usize i = 0; i < 2 * len; i++) {
+                usize v;
+                if (!read_unsigned(r, &v)) return 0;
+                code->operands[first + i].type = OPERAND_U;
+                code->operands[first + i].val = (Sint64)v;
+            }
+            o.type = OPERAND_ALLOC;
+            o.val = (Sint64)first;
+            o.len = (Uint32)len;
+            break;
+        }
+        case 4: {
+            usize index;
+            if (!read_unsigned(r, &index)) return 0;
+            o.type = OPERAND_LITERAL;
+            o.val = (Sint64)index;
+            break;
+        }
+        case 5: {
+            // type tagged register: the register followed by a type index we do not use
+            usize reg, type_index;
+            if (!read_tagged(r, &tag, &reg) || (tag != TAG_x && tag != TAG_y)) return 0;
+            if (!read_unsigned(r, &type_index)) return 0;
+            o.type = tag == TAG_x ? OPERAND_X : OPERAND_Y;
+            o.val = (Sint64)reg;
+            break;
+        }
+        default:
+            fprintf(stderr, "Unknown extended operand tag %zu\n", val);
+            return 0;
+        }
+        break;
+    }
+
+    code->operands[slot] = o;
+    return 1;
+}
+
+int parse_code(BeamCode *code, const byte *chunk_data, Uint32 chunk_size) {
+    Reader r;
+    reader_init(&r, chunk_data, chunk_size);
+
+    Sint32 header_size;
+    if (!reader_read_i32(&r, &header_size) || header_size < 16) {
+        fprintf(stderr, "Failed reading code header size\n");
+        return 0;
+    }
+
+    const byte *header;
+    if (!reader_read_bytes(&r, &header, (usize)header_size)) {
+        fprintf(stderr, "Code header truncated\n");
+        return 0;
+    }
+    if (!read_be32(header, header_size, &code->instruction_set) ||
+        !read_be32(header + 4, header_size - 4, &code->max_opcode) ||
+        !read_be32(header + 8, header_size - 8, &code->label_count) ||
+        !read_be32(header + 12, header_size - 12, &code->function_count)) {
+        fprintf(stderr, "Code header too short\n");
+        return 0;
+    }
+
+    if (code->max_opcode > MAX_OPCODE) {
+        fprintf(stderr, "Code uses opcode %u, this runtime knows up to %d\n", code->max_opcode, MAX_OPCODE);
+        return 0;
+    }
+    if (code->label_count > chunk_size) {
+        fprintf(stderr, "Label count %u exceeds chunk size\n", code->label_count);
+        return 0;
+    }
+
+    heap_init(&code->heap, 0);
+    code->labels = malloc((code->label_count + 1) * sizeof(Uint32));
+    if (!code->labels) {
+        perror("malloc failed");
+        exit(1);
+    }
+    for (Uint32 i = 0; i <= code->label_count; i++) code->labels[i] = LABEL_UNDEFINED;
+
+    while (reader_remaining(&r) > 0) {
+        byte op;
+        reader_read_u8(&r, &op);
+
+        const OpInfo *info = opcode_info(op);
+        if (!info) {
+            fprintf(stderr, "Unknown opcode %u at instruction %zu\n", op, code->instr_count);
+            return 0;
+        }
+
+        usize args = reserve_operands(code, info->arity);
+        for (int i = 0; i < info->arity; i++) {
+            if (!read_operand(&r, code, args + i, 0)) {
+                fprintf(stderr, "Failed reading operand %d of %s\n", i, info->name);
+                return 0;
+            }
+        }
+
+        if (op == op_label) {
+            Sint64 label = code->operands[args].val;
+            if (code->operands[args].type != OPERAND_U || label < 1 || label >= (Sint64)code->label_count) {
+                fprintf(stderr, "Label %" PRId64 " out of range\n", label);
+                return 0;
+            }
+            if (code->labels[label] != LABEL_UNDEFINED) {
+                fprintf(stderr, "Label %" PRId64 " defined twice\n", label);
+                return 0;
+            }
+            code->labels[label] = (Uint32)code->instr_count;
+        }
+
+        add_instr(code, op, info->arity, args);
+        if (op == op_int_code_end) break;
+    }
+    return 1;
+}
+
+void free_code(BeamCode *code) {
+    free(code->instrs);
+    free(code->operands);
+    free(code->labels);
+    heap_free(&code->heap);
+    memset(code, 0, sizeof(BeamCode));
+}
+
+static void print_operand(FILE *out, const BeamCode *code, const Operand *o) {
+    switch (o->type) {
+    case OPERAND_U:       fprintf(out, "%" PRId64, o->val); break;
+    case OPERAND_I:       fprintf(out, "%" PRId64, o->val); break;
+    case OPERAND_ATOM:
+        if (o->val == 0) fprintf(out, "nil");
+        else fprintf(out, "atom:%" PRId64, o->val);
+        break;
+    case OPERAND_X:       fprintf(out, "x%" PRId64, o->val); break;
+    case OPERAND_Y:       fprintf(out, "y%" PRId64, o->val); break;
+    case OPERAND_LABEL:   fprintf(out, "f%" PRId64, o->val); break;
+    case OPERAND_CHAR:    fprintf(out, "$%c", (int)o->val); break;
+    case OPERAND_FR:      fprintf(out, "fr%" PRId64, o->val); break;
+    case OPERAND_LITERAL: fprintf(out, "lit:%" PRId64, o->val); break;
+    case OPERAND_BIG:     print_term(out, (Eterm)o->val); break;
+    case OPERAND_LIST:
+    case OPERAND_ALLOC: {
+        usize n = o->type == OPERAND_LIST ? o->len : 2 * o->len;
+        fprintf(out, "[");
+        for (usize i = 0; i < n; i++) {
+            if (i) fprintf(out, ",");
+            print_operand(out, code, &code->operands[o->val + i]);
+        }
+        fprintf(out, "]");
+        break;
+    }
+    }
+}
+
+void print_code(FILE *out, const BeamCode *code) {
+    for (usize i = 0; i < code->instr_count; i++) {
+        const Instr *in = &code->instrs[i];
+        fprintf(out, "%s%s", in->op == op_label ? "" : "    ", opcode_table[in->op].name);
+        for (int a = 0; a < in->arity; a++) {
+            fprintf(out, a ? ", " : " ");
+            print_operand(out, code, instr_arg(code, in, a));
+        }
+        fprintf(out, "\n");
+    }
+}
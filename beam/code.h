@@ -0,0 +1,84 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "binary_parsing_helpers.h"
+#include "term.h"
+#include "heap.h"
+#include "opcodes.h"
+
+/*
+Decoded "Code" chunk.
+
+Instructions are stored as (opcode, arity, index of the first operand) and
+all operands of a module live in one pool. List operands (select_val tables,
+get_map_elements key lists, ...) point at a run of operands in the same pool.
+*/
+
+// compact term encoding tags
+#define TAG_u 0
+#define TAG_i 1
+#define TAG_a 2
+#define TAG_x 3
+#define TAG_y 4
+#define TAG_f 5
+#define TAG_h 6
+#define TAG_z 7
+
+typedef enum {
+    OPERAND_U,          // unsigned literal
+    OPERAND_I,          // integer literal
+    OPERAND_ATOM,       // index into the module atom table, 0 means nil
+    OPERAND_X,          // x register
+    OPERAND_Y,          // y register
+    OPERAND_LABEL,
+    OPERAND_CHAR,
+    OPERAND_LIST,       // val = first operand in the pool, len = count
+    OPERAND_FR,         // float register
+    OPERAND_ALLOC,      // allocation list, stored like a list of (kind, count) pairs
+    OPERAND_LITERAL,    // index into the module literal table
+    OPERAND_BIG         // integer literal too large for a small, val is the bignum term
+} OperandType;
+
+typedef struct {
+    byte type;
+    Uint32 len;
+    Sint64 val;
+} Operand;
+
+#define LABEL_UNDEFINED UINT32_MAX
+
+typedef struct {
+    Uint16 op;
+    Uint16 arity;
+    Uint32 args;        // first operand in BeamCode.operands
+} Instr;
+
+typedef struct {
+    Uint32 instruction_set;
+    Uint32 max_opcode;
+    Uint32 label_count;
+    Uint32 function_count;
+
+    Instr *instrs;
+    usize instr_count;
+
+    Operand *operands;
+    usize operand_count;
+
+    // label number -> index of its label instruction, LABEL_UNDEFINED if undefined
+    Uint32 *labels;
+
+    // terms created while decoding (bignum operands)
+    Heap heap;
+} BeamCode;
+
+int parse_code(BeamCode *code, const byte *chunk_data, Uint32 chunk_size);
+void free_code(BeamCode *code);
+
+static inline const Operand *instr_arg(const BeamCode *code, const Instr *in, int i) {
+    return &code->operands[in->args + i];
+}
+
+void print_code(FILE *out, const BeamCode *code);
@@ -0,0 +1,182 @@
+#include "etf.h"
+#include "atom.h"
+#include "big.h"
+#include "map.h"
+
+static int read_u16(Reader *r, usize *out) {
+    const byte *p;
+    if (!reader_read_bytes(r, &p, 2)) return 0;
+    *out = ((usize)p[0] << 8) | p[1];
+    return 1;
+}
+
+static int read_u32(Reader *r, usize *out) {
+    const byte *p;
+    Uint32 v;
+    if (!reader_read_bytes(r, &p, 4) || !read_be32(p, 4, &v)) return 0;
+    *out = v;
+    return 1;
+}
+
+static int decode_atom(Reader *r, usize len, Eterm *out) {
+    const byte *name;
+    if (!reader_read_bytes(r, &name, len)) return 0;
+    *out = make_atom(atom_put((const char *)name, len));
+    return 1;
+}
+
+static int decode_term(Reader *r, Heap *heap, Eterm *out, int depth);
+
+static int decode_tuple(Reader *r, Heap *heap, usize arity, Eterm *out, int depth) {
+    // every element takes at least one byte, refuse counts the data cannot hold
+    if (arity > reader_remaining(r)) return 0;
+
+    Eterm *hp = heap_alloc(heap, 1 + arity);
+    Eterm tuple = make_tuple(&hp, arity);
+    for (usize i = 1; i <= arity; i++) {
+        if (!decode_term(r, heap, &tuple_element(tuple, i), depth + 1)) return 0;
+    }
+    *out = tuple;
+    return 1;
+}
+
+static int decode_list(Reader *r, Heap *heap, Eterm *out, int depth) {
+    usize len;
+    if (!read_u32(r, &len) || len > reader_remaining(r)) return 0;
+
+    Eterm *cells = heap_alloc(heap, 2 * len);
+    Eterm *tail = out;
+    for (usize i = 0; i < len; i++) {
+        Eterm *cell = cells + 2 * i;
+        if (!decode_term(r, heap, &CAR(cell), depth + 1)) return 0;
+        *tail = make_list(cell);
+        tail = &CDR(cell);
+    }
+    return decode_term(r, heap, tail, depth + 1);
+}
+
+static int decode_string(Reader *r, Heap *heap, Eterm *out) {
+    usize len;
+    const byte *chars;
+    if (!read_u16(r, &len) || !reader_read_bytes(r, &chars, len)) return 0;
+
+    Eterm *hp = heap_alloc(heap, 2 * len);
+    Eterm list = NIL;
+    for (usize i = len; i > 0; i--) {
+        list = make_cons(&hp, make_small(chars[i - 1]), list);
+    }
+    *out = list;
+    return 1;
+}
+
+static int decode_big(Reader *r, Heap *heap, usize len, Eterm *out) {
+    byte sign;
+    const byte *digits;
+    if (!reader_read_u8(r, &sign) || !reader_read_bytes(r, &digits, len)) return 0;
+
+    Eterm big = big_from_bytes_le(heap, digits, len, sign != 0);
+    if (!is_value(big)) return 0;
+    *out = big;
+    return 1;
+}
+
+static int decode_map(Reader *r, Heap *heap, Eterm *out, int depth) {
+    usize n;
+    // every pair takes at least two bytes
+    if (!read_u32(r, &n) || n > reader_remaining(r) / 2) return 0;
+
+    Eterm *kvs = malloc((2 * n + 1) * sizeof(Eterm));
+    if (!kvs) {
+        perror("malloc failed");
+        exit(1);
+    }
+    int ok = 1;
+    for (usize i = 0; i < 2 * n && ok; i++) {
+        ok = decode_term(r, heap, &kvs[i], depth + 1);
+    }
+    if (ok) *out = map_from_pairs(heap, kvs, n);
+    free(kvs);
+    return ok;
+}
+
+static int decode_term(Reader *r, Heap *heap, Eterm *out, int depth) {
+    byte tag;
+    usize len;
+
+    if (depth > ETF_MAX_DEPTH) return 0;
+    if (!reader_read_u8(r, &tag)) return 0;
+
+    switch (tag) {
+    case SMALL_INTEGER_EXT: {
+        byte v;
+        if (!reader_read_u8(r, &v)) return 0;
+        *out = make_small(v);
+        return 1;
+    }
+    case INTEGER_EXT: {
+        Sint32 v;
+        if (!reader_read_i32(r, &v)) return 0;
+        *out = make_small(v);
+        return 1;
+    }
+    case NEW_FLOAT_EXT: {
+        const byte *p;
+        if (!reader_read_bytes(r, &p, 8)) return 0;
+        Uint64 bits = 0;
+        for (int i = 0; i < 8; i++) bits = (bits << 8) | p[i];
+        double d;
+        memcpy(&d, &bits, sizeof(double));
+        Eterm *hp = heap_alloc(heap, FLOAT_SIZE);
+        *out = make_float(&hp, d);
+        return 1;
+    }
+    case ATOM_EXT:
+    case ATOM_UTF8_EXT:
+        return read_u16(r, &len) && decode_atom(r, len, out);
+    case SMALL_ATOM_EXT:
+    case SMALL_ATOM_UTF8_EXT: {
+        byte n;
+        return reader_read_u8(r, &n) && decode_atom(r, n, out);
+    }
+    case SMALL_TUPLE_EXT: {
+        byte n;
+        return reader_read_u8(r, &n) && decode_tuple(r, heap, n, out, depth);
+    }
+    case LARGE_TUPLE_EXT:
+        return read_u32(r, &len) && decode_tuple(r, heap, len, out, depth);
+    case NIL_EXT:
+        *out = NIL;
+        return 1;
+    case STRING_EXT:
+        return decode_string(r, heap, out);
+    case LIST_EXT:
+        return decode_list(r, heap, out, depth);
+    case BINARY_EXT: {
+        const byte *data;
+        if (!read_u32(r, &len) || !reader_read_bytes(r, &data, len)) return 0;
+        Eterm *hp = heap_alloc(heap, 1 + BINARY_WORDS(len));
+        *out = make_binary(&hp, data, len);
+        return 1;
+    }
+    case SMALL_BIG_EXT: {
+        byte n;
+        return reader_read_u8(r, &n) && decode_big(r, heap, n, out);
+    }
+    case LARGE_BIG_EXT:
+        return read_u32(r, &len) && decode_big(r, heap, len, out);
+    case MAP_EXT:
+        return decode_map(r, heap, out, depth);
+    default:
+        fprintf(stderr, "Unsupported external term tag %u\n", tag);
+        return 0;
+    }
+}
+
+int etf_decode(const byte *data, usize size, Heap *heap, Eterm *out) {
+    Reader r;
+    byte version;
+
+    reader_init(&r, data, size);
+    if (!reader_read_u8(&r, &version) || version != ETF_VERSION) return 0;
+    return decode_term(&r, heap, out, 0);
+}
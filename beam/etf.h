@@ -0,0 +1,37 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "binary_parsing_helpers.h"
+#include "term.h"
+#include "heap.h"
+
+/*
+External term format (term_to_binary) decoding, used for the literal chunk.
+Atoms are put into the global atom table.
+*/
+#define ETF_VERSION          131
+
+#define NEW_FLOAT_EXT        70
+#define SMALL_INTEGER_EXT    97
+#define INTEGER_EXT          98
+#define ATOM_EXT             100
+#define SMALL_TUPLE_EXT      104
+#define LARGE_TUPLE_EXT      105
+#define NIL_EXT              106
+#define STRING_EXT           107
+#define LIST_EXT             108
+#define BINARY_EXT           109
+#define SMALL_BIG_EXT        110
+#define LARGE_BIG_EXT        111
+#define SMALL_ATOM_EXT       115
+#define MAP_EXT              116
+#define ATOM_UTF8_EXT        118
+#define SMALL_ATOM_UTF8_EXT  119
+
+// nesting deeper than this is rejected
+#define ETF_MAX_DEPTH        1000
+
+// decodes the term in data (starting with the version byte) onto heap, returns 1 on success
+int etf_decode(const byte *data, usize size, Heap *heap, Eterm *out);
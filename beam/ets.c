@@ -0,0 +1,813 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include "ets.h"
+#include "arith.h"
+#include "big.h"
+
+#define CACHE_LINE 64
+
+/*
+A table lock. With read_concurrency it is a rwlock so lookups run in
+parallel, otherwise a plain mutex which is cheaper when writes dominate.
+The ordered_set lock is always a rwlock with write_concurrency, its writers
+share it. Padded to a cache line so neighbouring stripes do not share one.
+*/
+typedef struct {
+    _Alignas(CACHE_LINE) union {
+        pthread_rwlock_t rw;
+        pthread_mutex_t mtx;
+    } u;
+} EtsLock;
+
+/*
+A stored object: the tuple is flattened into mem, which is owned by the table.
+*/
+typedef struct db_object {
+    struct db_object *next;     // bucket chain (hash tables)
+    Uint64 hash;                // hash of the key
+    Eterm tuple;                // points into mem
+    usize words;                // size of mem
+    Eterm mem[];
+} DbObject;
+
+#define SKIP_MAX_LEVEL 24
+
+/*
+The key is copied into the node (after forward[]) and never changes, so a
+search can compare keys while the object is being replaced. obj is read
+and replaced under the node lock, the forward links change under the lock
+of the node they belong to.
+*/
+typedef struct skip_node {
+    DbObject *obj;              // NULL for the head
+    Eterm key;
+    int level;
+    atomic_bool locked;         // node lock, only used with write_concurrency
+    _Atomic(struct skip_node *) forward[];
+} SkipNode;
+
+// stripes with write_concurrency, must be a power of two
+#define ETS_LOCK_STRIPES   64
+#define ETS_MIN_BUCKETS    256
+// grow when the average chain is longer than this
+#define ETS_MAX_LOAD       2
+
+struct ets_table {
+    Eterm name;
+    EtsType type;
+    int keypos;
+    int flags;
+    int rwlock;                 // the table locks are rwlocks, see EtsLock
+    atomic_size_t size;
+
+    // set and bag: bucket i is guarded by locks[i & (lock_count - 1)]
+    EtsLock *locks;
+    usize lock_count;
+    DbObject **buckets;
+    usize bucket_count;
+
+    /*
+    ordered_set: readers hold tree_lock shared. Writers that only link nodes
+    or replace objects hold it shared with write_concurrency (and lock the
+    nodes they change), exclusive otherwise. Delete always holds it
+    exclusive, so no search can be looking at the node it frees.
+    */
+    EtsLock tree_lock;
+    SkipNode *head;
+    _Atomic int level;          // highest level in use, where lookups start
+};
+
+/* -- locking -- */
+
+static void lock_init(EtsTable *t, EtsLock *l) {
+    if (t->rwlock) {
+        pthread_rwlock_init(&l->u.rw, NULL);
+    } else {
+        pthread_mutex_init(&l->u.mtx, NULL);
+    }
+}
+
+static void lock_destroy(EtsTable *t, EtsLock *l) {
+    if (t->rwlock) {
+        pthread_rwlock_destroy(&l->u.rw);
+    } else {
+        pthread_mutex_destroy(&l->u.mtx);
+    }
+}
+
+static void lock_read(EtsTable *t, EtsLock *l) {
+    if (t->rwlock) {
+        pthread_rwlock_rdlock(&l->u.rw);
+    } else {
+        pthread_mutex_lock(&l->u.mtx);
+    }
+}
+
+static void lock_write(EtsTable *t, EtsLock *l) {
+    if (t->rwlock) {
+        pthread_rwlock_wrlock(&l->u.rw);
+    } else {
+        pthread_mutex_lock(&l->u.mtx);
+    }
+}
+
+static void unlock(EtsTable *t, EtsLock *l) {
+    if (t->rwlock) {
+        pthread_rwlock_unlock(&l->u.rw);
+    } else {
+        pthread_mutex_unlock(&l->u.mtx);
+    }
+}
+
+static EtsLock *bucket_lock(EtsTable *t, Uint64 hash) {
+    return &t->locks[hash & (t->lock_count - 1)];
+}
+
+/* -- stored objects -- */
+
+static Eterm object_key(const EtsTable *t, const DbObject *obj) {
+    return tuple_element(obj->tuple, t->keypos);
+}
+
+// copies tuple into a new object, done before taking any lock
+static DbObject *new_object(EtsTable *t, Eterm tuple) {
+    usize words = term_size(tuple);
+    DbObject *obj = malloc(sizeof(DbObject) + words * sizeof(Eterm));
+    if (!obj) {
+        perror("malloc failed");
+        exit(1);
+    }
+
+    Eterm *hp = obj->mem;
+    obj->next = NULL;
+    obj->words = words;
+    obj->tuple = copy_term(tuple, &hp);
+    obj->hash = term_hash(tuple_element(tuple, t->keypos));
+    return obj;
+}
+
+// copies a stored object onto the caller's heap
+static Eterm object_to_heap(const DbObject *obj, Heap *heap) {
+    Eterm *hp = heap_alloc(heap, obj->words);
+    return copy_term(obj->tuple, &hp);
+}
+
+static int valid_object(const EtsTable *t, Eterm tuple) {
+    return is_tuple(tuple) && tuple_arity(tuple) >= (usize)t->keypos;
+}
+
+/* -- table registry (named tables) -- */
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static EtsTable **registry;
+static usize registry_count;
+
+static int registry_add(EtsTable *t) {
+    pthread_mutex_lock(&registry_lock);
+    for (usize i = 0; i < registry_count; i++) {
+        if (registry[i]->name == t->name) {
+            pthread_mutex_unlock(&registry_lock);
+            return 0;
+        }
+    }
+    registry = realloc(registry, sizeof(EtsTable *) * (registry_count + 1));
+    if (!registry) {
+        perror("realloc failed");
+        exit(1);
+    }
+    registry[registry_count++] = t;
+    pthread_mutex_unlock(&registry_lock);
+    return 1;
+}
+
+static void registry_remove(EtsTable *t) {
+    pthread_mutex_lock(&registry_lock);
+    for (usize i = 0; i < registry_count; i++) {
+        if (registry[i] == t) {
+            registry[i] = registry[--registry_count];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&registry_lock);
+}
+
+EtsTable *ets_whereis(Eterm name) {
+    EtsTable *found = NULL;
+    pthread_mutex_lock(&registry_lock);
+    for (usize i = 0; i < registry_count; i++) {
+        if (registry[i]->name == name) {
+            found = registry[i];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&registry_lock);
+    return found;
+}
+
+/* -- skiplist (ordered_set) -- */
+
+static SkipNode *new_skip_node(EtsTable *t, DbObject *obj, int level) {
+    usize key_words = obj ? term_size(object_key(t, obj)) : 0;
+    SkipNode *n = malloc(sizeof(SkipNode) + level * sizeof(n->forward[0]) + key_words * sizeof(Eterm));
+    if (!n) {
+        perror("malloc failed");
+        exit(1);
+    }
+    n->obj = obj;
+    n->key = NIL;
+    n->level = level;
+    atomic_init(&n->locked, 0);
+    for (int i = 0; i < level; i++) atomic_init(&n->forward[i], NULL);
+    if (obj) {
+        Eterm *hp = (Eterm *)&n->forward[level];
+        n->key = copy_term(object_key(t, obj), &hp);
+    }
+    return n;
+}
+
+static SkipNode *next_node(SkipNode *n, int level) {
+    return atomic_load_explicit(&n->forward[level], memory_order_acquire);
+}
+
+// node locks are only needed while writers share the tree lock
+static void node_lock(const EtsTable *t, SkipNode *n) {
+    if (!(t->flags & ETS_WRITE_CONCURRENCY)) return;
+    while (atomic_exchange_explicit(&n->locked, 1, memory_order_acquire)) {
+        for (int spins = 0; atomic_load_explicit(&n->locked, memory_order_relaxed); spins++) {
+            if (spins >= 64) sched_yield();
+        }
+    }
+}
+
+static void node_unlock(const EtsTable *t, SkipNode *n) {
+    if (!(t->flags & ETS_WRITE_CONCURRENCY)) return;
+    atomic_store_explicit(&n->locked, 0, memory_order_release);
+}
+
+// the tree lock for insert and update_counter
+static void lock_tree_writer(EtsTable *t) {
+    if (t->flags & ETS_WRITE_CONCURRENCY) {
+        lock_read(t, &t->tree_lock);
+    } else {
+        lock_write(t, &t->tree_lock);
+    }
+}
+
+// p = 1/4 per level, every thread draws from its own generator
+static int random_level(void) {
+    static _Thread_local Uint64 state;
+    if (state == 0) state = 0x9e3779b97f4a7c15ULL ^ (Uint64)(uintptr_t)&state;
+
+    // xorshift64
+    Uint64 x = state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    state = x;
+
+    int level = 1;
+    while (level < SKIP_MAX_LEVEL && (x & 3) == 0) {
+        level++;
+        x >>= 2;
+    }
+    return level;
+}
+
+/*
+Finds the last node on every level whose key is less than key. If preds is
+not NULL it receives those nodes (on every level) and succs the node after
+each. Returns the first node with key >= key. Takes no node locks: keys
+never change and nodes are only freed under the exclusive tree lock.
+*/
+static SkipNode *skip_search(EtsTable *t, Eterm key, SkipNode **preds, SkipNode **succs) {
+    SkipNode *x = t->head, *next = NULL;
+    int top = preds ? SKIP_MAX_LEVEL : atomic_load_explicit(&t->level, memory_order_relaxed);
+    for (int i = top - 1; i >= 0; i--) {
+        next = next_node(x, i);
+        while (next && term_cmp(next->key, key) < 0) {
+            x = next;
+            next = next_node(x, i);
+        }
+        if (preds) {
+            preds[i] = x;
+            succs[i] = next;
+        }
+    }
+    return next;
+}
+
+static SkipNode *skip_find(EtsTable *t, Eterm key) {
+    SkipNode *n = skip_search(t, key, NULL, NULL);
+    if (n && term_cmp(n->key, key) == 0) return n;
+    return NULL;
+}
+
+// unlocks preds[0..level), each node once (a node is the pred of adjacent levels)
+static void unlock_preds(const EtsTable *t, SkipNode **preds, int level) {
+    for (int i = 0; i < level; i++) {
+        if (i == 0 || preds[i] != preds[i - 1]) node_unlock(t, preds[i]);
+    }
+}
+
+/*
+Lazy skiplist insert: search without locks, then lock the predecessors
+from level 0 up and check that they still point at the successors found.
+Predecessors on higher levels never come after the ones below, so every
+writer locks nodes in descending key order and they cannot deadlock. If
+anything was linked in between, unlock and search again.
+*/
+static void skip_insert(EtsTable *t, DbObject *obj) {
+    SkipNode *preds[SKIP_MAX_LEVEL], *succs[SKIP_MAX_LEVEL];
+    Eterm key = object_key(t, obj);
+    int level = random_level();
+    SkipNode *n = new_skip_node(t, obj, level);
+
+    lock_tree_writer(t);
+    for (;;) {
+        SkipNode *found = skip_search(t, key, preds, succs);
+        if (found && term_cmp(found->key, key) == 0) {
+            node_lock(t, found);
+            DbObject *old = found->obj;
+            found->obj = obj;
+            node_unlock(t, found);
+            unlock(t, &t->tree_lock);
+            free(old);
+            free(n);
+            return;
+        }
+
+        int locked = 0, valid = 1;
+        while (valid && locked < level) {
+            if (locked == 0 || preds[locked] != preds[locked - 1]) node_lock(t, preds[locked]);
+            valid = atomic_load_explicit(&preds[locked]->forward[locked], memory_order_relaxed) == succs[locked];
+            locked++;
+        }
+        if (valid) break;
+        unlock_preds(t, preds, locked);
+    }
+
+    // the node is complete before it becomes visible on any level
+    for (int i = 0; i < level; i++) atomic_store_explicit(&n->forward[i], succs[i], memory_order_relaxed);
+    for (int i = 0; i < level; i++) atomic_store_explicit(&preds[i]->forward[i], n, memory_order_release);
+    unlock_preds(t, preds, level);
+
+    int top = atomic_load_explicit(&t->level, memory_order_relaxed);
+    while (top < level && !atomic_compare_exchange_weak_explicit(&t->level, &top, level, memory_order_relaxed,
+                                                                memory_order_relaxed)) {
+    }
+    atomic_fetch_add(&t->size, 1);
+    unlock(t, &t->tree_lock);
+}
+
+static int skip_delete(EtsTable *t, Eterm key) {
+    SkipNode *preds[SKIP_MAX_LEVEL], *succs[SKIP_MAX_LEVEL];
+
+    lock_write(t, &t->tree_lock);
+    SkipNode *n = skip_search(t, key, preds, succs);
+    if (!n || term_cmp(n->key, key) != 0) {
+        unlock(t, &t->tree_lock);
+        return 1;
+    }
+
+    for (int i = 0; i < n->level; i++) {
+        atomic_store_explicit(&preds[i]->forward[i], next_node(n, i), memory_order_relaxed);
+    }
+    int top = atomic_load_explicit(&t->level, memory_order_relaxed);
+    while (top > 1 && next_node(t->head, top - 1) == NULL) top--;
+    atomic_store_explicit(&t->level, top, memory_order_relaxed);
+    atomic_fetch_sub(&t->size, 1);
+    unlock(t, &t->tree_lock);
+
+    free(n->obj);
+    free(n);
+    return 1;
+}
+
+/* -- hash tables (set, bag) -- */
+
+static DbObject **bucket_of(EtsTable *t, Uint64 hash) {
+    return &t->buckets[hash & (t->bucket_count - 1)];
+}
+
+/*
+Doubles the bucket array. Takes every stripe in order, so nobody can be
+looking at the old array. The bucket count stays a multiple of the stripe
+count, which keeps each key under the same stripe after the resize.
+Old bucket i splits into new buckets i and i + bucket_count; both are
+built in chain order, so bag objects with equal keys keep their order.
+*/
+static void grow_buckets(EtsTable *t) {
+    for (usize i = 0; i < t->lock_count; i++) lock_write(t, &t->locks[i]);
+
+    if (atomic_load(&t->size) > t->bucket_count * ETS_MAX_LOAD) {
+        usize new_count = t->bucket_count * 2;
+        DbObject **nb = calloc(new_count, sizeof(DbObject *));
+        if (!nb) {
+            perror("calloc failed");
+            exit(1);
+        }
+
+        for (usize i = 0; i < t->bucket_count; i++) {
+            DbObject **low = &nb[i], **high = &nb[i + t->bucket_count];
+            for (DbObject *obj = t->buckets[i]; obj; obj = obj->next) {
+                if (obj->hash & t->bucket_count) {
+                    *high = obj;
+                    high = &obj->next;
+                } else {
+                    *low = obj;
+                    low = &obj->next;
+                }
+            }
+            *low = NULL;
+            *high = NULL;
+        }
+        free(t->buckets);
+        t->buckets = nb;
+        t->bucket_count = new_count;
+    }
+
+    for (usize i = t->lock_count; i > 0; i--) unlock(t, &t->locks[i - 1]);
+}
+
+static void hash_insert(EtsTable *t, DbObject *obj) {
+    Eterm key = object_key(t, obj);
+    EtsLock *l = bucket_lock(t, obj->hash);
+    DbObject *garbage = NULL;
+    int added = 1;
+
+    lock_write(t, l);
+    DbObject **pp = bucket_of(t, obj->hash);
+
+    if (t->type == ETS_SET) {
+        for (; *pp; pp = &(*pp)->next) {
+            if ((*pp)->hash == obj->hash && term_eq(object_key(t, *pp), key)) {
+                // replace in place
+                garbage = *pp;
+                obj->next = garbage->next;
+                *pp = obj;
+                added = 0;
+                break;
+            }
+        }
+    } else {
+        // bag: objects with the same key are kept together, duplicates dropped
+        DbObject **same = NULL;
+        for (; *pp; pp = &(*pp)->next) {
+            if ((*pp)->hash == obj->hash && term_eq(object_key(t, *pp), key)) {
+                if (term_eq((*pp)->tuple, obj->tuple)) {
+                    garbage = obj;
+                    added = 0;
+                    break;
+                }
+                same = &(*pp)->next;
+            }
+        }
+        if (added && same) pp = same;
+    }
+
+    if (added) {
+        obj->next = *pp;
+        *pp = obj;
+    }
+    // grow_buckets changes bucket_count under every stripe, read it under ours
+    usize limit = t->bucket_count * ETS_MAX_LOAD;
+    unlock(t, l);
+
+    free(garbage);
+
+    if (added && atomic_fetch_add(&t->size, 1) + 1 > limit) {
+        grow_buckets(t);
+    }
+}
+
+static int hash_delete(EtsTable *t, Eterm key) {
+    Uint64 hash = term_hash(key);
+    EtsLock *l = bucket_lock(t, hash);
+    DbObject *garbage = NULL;
+    usize removed = 0;
+
+    lock_write(t, l);
+    DbObject **pp = bucket_of(t, hash);
+    while (*pp) {
+        DbObject *obj = *pp;
+        if (obj->hash == hash && term_eq(object_key(t, obj), key)) {
+            *pp = obj->next;
+            obj->next = garbage;
+            garbage = obj;
+            removed++;
+        } else {
+            pp = &obj->next;
+        }
+    }
+    unlock(t, l);
+
+    atomic_fetch_sub(&t->size, removed);
+    while (garbage) {
+        DbObject *next = garbage->next;
+        free(garbage);
+        garbage = next;
+    }
+    return 1;
+}
+
+// the link pointing at the first object with key, NULL if there is none
+static DbObject **hash_find_link(EtsTable *t, Eterm key, Uint64 hash) {
+    for (DbObject **pp = bucket_of(t, hash); *pp; pp = &(*pp)->next) {
+        if ((*pp)->hash == hash && term_eq(object_key(t, *pp), key)) return pp;
+    }
+    return NULL;
+}
+
+static DbObject *hash_find(EtsTable *t, Eterm key, Uint64 hash) {
+    DbObject **pp = hash_find_link(t, key, hash);
+    return pp ? *pp : NULL;
+}
+
+/* -- public interface -- */
+
+EtsTable *ets_new(Eterm name, EtsType type, int keypos, int flags) {
+    if (keypos < 1) return NULL;
+
+    EtsTable *t = calloc(1, sizeof(EtsTable));
+    if (!t) {
+        perror("calloc failed");
+        exit(1);
+    }
+    t->name = name;
+    t->type = type;
+    t->keypos = keypos;
+    t->flags = flags;
+    t->rwlock = (flags & ETS_READ_CONCURRENCY) || (type == ETS_ORDERED_SET && (flags & ETS_WRITE_CONCURRENCY));
+    atomic_init(&t->size, 0);
+
+    if (type == ETS_ORDERED_SET) {
+        lock_init(t, &t->tree_lock);
+        t->head = new_skip_node(t, NULL, SKIP_MAX_LEVEL);
+        atomic_init(&t->level, 1);
+    } else {
+        t->lock_count = (flags & ETS_WRITE_CONCURRENCY) ? ETS_LOCK_STRIPES : 1;
+        t->locks = aligned_alloc(CACHE_LINE, t->lock_count * sizeof(EtsLock));
+        t->bucket_count = ETS_MIN_BUCKETS;
+        t->buckets = calloc(t->bucket_count, sizeof(DbObject *));
+        if (!t->locks || !t->buckets) {
+            perror("alloc failed");
+            exit(1);
+        }
+        for (usize i = 0; i < t->lock_count; i++) lock_init(t, &t->locks[i]);
+    }
+
+    if ((flags & ETS_NAMED_TABLE) && !registry_add(t)) {
+        ets_delete_table(t);
+        return NULL;
+    }
+    return t;
+}
+
+void ets_delete_table(EtsTable *t) {
+    if (t->flags & ETS_NAMED_TABLE) registry_remove(t);
+
+    if (t->type == ETS_ORDERED_SET) {
+        SkipNode *n = t->head;
+        while (n) {
+            SkipNode *next = next_node(n, 0);
+            free(n->obj);
+            free(n);
+            n = next;
+        }
+        lock_destroy(t, &t->tree_lock);
+    } else {
+        for (usize i = 0; i < t->bucket_count; i++) {
+            DbObject *obj = t->buckets[i];
+            while (obj) {
+                DbObject *next = obj->next;
+                free(obj);
+                obj = next;
+            }
+        }
+        for (usize i = 0; i < t->lock_count; i++) lock_destroy(t, &t->locks[i]);
+        free(t->buckets);
+        free(t->locks);
+    }
+    free(t);
+}
+
+int ets_insert(EtsTable *t, Eterm tuple) {
+    if (!valid_object(t, tuple)) return 0;
+
+    DbObject *obj = new_object(t, tuple);
+    if (t->type == ETS_ORDERED_SET) {
+        skip_insert(t, obj);
+    } else {
+        hash_insert(t, obj);
+    }
+    return 1;
+}
+
+int ets_lookup(EtsTable *t, Eterm key, Heap *heap, Eterm *out) {
+    Eterm result = NIL;
+
+    if (t->type == ETS_ORDERED_SET) {
+        lock_read(t, &t->tree_lock);
+        SkipNode *n = skip_find(t, key);
+        if (n) {
+            Eterm *hp = heap_alloc(heap, 2);
+            node_lock(t, n);
+            result = make_cons(&hp, object_to_heap(n->obj, heap), NIL);
+            node_unlock(t, n);
+        }
+        unlock(t, &t->tree_lock);
+        *out = result;
+        return 1;
+    }
+
+    Uint64 hash = term_hash(key);
+    EtsLock *l = bucket_lock(t, hash);
+    lock_read(t, l);
+
+    // bag objects with equal keys are adjacent; build the list back to front
+    Eterm *tail = &result;
+    for (DbObject *obj = hash_find(t, key, hash); obj; obj = obj->next) {
+        if (obj->hash != hash || !term_eq(object_key(t, obj), key)) break;
+        Eterm *hp = heap_alloc(heap, 2);
+        Eterm cell = make_cons(&hp, object_to_heap(obj, heap), NIL);
+        *tail = cell;
+        tail = &CDR(list_val(cell));
+        if (t->type == ETS_SET) break;
+    }
+    unlock(t, l);
+
+    *out = result;
+    return 1;
+}
+
+int ets_member(EtsTable *t, Eterm key) {
+    int found;
+
+    if (t->type == ETS_ORDERED_SET) {
+        lock_read(t, &t->tree_lock);
+        found = skip_find(t, key) != NULL;
+        unlock(t, &t->tree_lock);
+        return found;
+    }
+
+    Uint64 hash = term_hash(key);
+    EtsLock *l = bucket_lock(t, hash);
+    lock_read(t, l);
+    found = hash_find(t, key, hash) != NULL;
+    unlock(t, l);
+    return found;
+}
+
+int ets_delete(EtsTable *t, Eterm key) {
+    if (t->type == ETS_ORDERED_SET) return skip_delete(t, key);
+    return hash_delete(t, key);
+}
+
+/*
+A small counter that stays small is an immediate, it is updated in place
+under the lock that guards the object without copying it. A sum outside the small
+range (or a counter that already is a bignum) needs words the object does
+not have: the object is rebuilt around the new value and returned in
+*replaced, for the caller to link in place of obj and free obj once the
+lock is dropped. The new value is copied onto heap.
+*/
+static int bump_counter(EtsTable *t, DbObject *obj, int pos, Eterm incr, Heap *heap, Eterm *result,
+                        DbObject **replaced) {
+    *replaced = NULL;
+    if (!obj) return 0;
+    if (pos < 1 || (usize)pos > tuple_arity(obj->tuple) || pos == t->keypos) return 0;
+
+    Eterm *slot = &tuple_val(obj->tuple)[pos];
+    if (!is_integer(*slot) || !is_integer(incr)) return 0;
+
+    if (both_small(*slot, incr)) {
+        // two smalls cannot overflow 64 bits
+        Sint64 value = small_value(*slot) + small_value(incr);
+        if (IS_SSMALL(value)) {
+            *slot = make_small(value);
+            *result = *slot;
+            return 1;
+        }
+    }
+
+    Heap scratch;
+    heap_init(&scratch, obj->words + 8);
+    Eterm tuple = object_to_heap(obj, &scratch);
+    Eterm sum = arith_plus(&scratch, tuple_element(tuple, pos), incr);
+    if (is_value(sum)) {
+        tuple_element(tuple, pos) = sum;
+        *replaced = new_object(t, tuple);
+        Eterm *hp = heap_alloc(heap, term_size(sum));
+        *result = copy_term(sum, &hp);
+    }
+    heap_free(&scratch);
+    return is_value(sum);
+}
+
+int ets_update_counter(EtsTable *t, Eterm key, int pos, Eterm incr, Heap *heap, Eterm *result) {
+    DbObject *replaced;
+    DbObject *garbage = NULL;
+    int ok;
+
+    if (t->type == ETS_BAG) return 0;
+
+    if (t->type == ETS_ORDERED_SET) {
+        lock_tree_writer(t);
+        SkipNode *n = skip_find(t, key);
+        if (n) node_lock(t, n);
+        ok = bump_counter(t, n ? n->obj : NULL, pos, incr, heap, result, &replaced);
+        if (replaced) {
+            garbage = n->obj;
+            n->obj = replaced;
+        }
+        if (n) node_unlock(t, n);
+        unlock(t, &t->tree_lock);
+        free(garbage);
+        return ok;
+    }
+
+    Uint64 hash = term_hash(key);
+    EtsLock *l = bucket_lock(t, hash);
+    lock_write(t, l);
+    DbObject **pp = hash_find_link(t, key, hash);
+    ok = bump_counter(t, pp ? *pp : NULL, pos, incr, heap, result, &replaced);
+    if (replaced) {
+        garbage = *pp;
+        replaced->next = garbage->next;
+        *pp = replaced;
+    }
+    unlock(t, l);
+    free(garbage);
+    return ok;
+}
+
+static Eterm key_to_heap(EtsTable *t, const DbObject *obj, Heap *heap) {
+    Eterm key = object_key(t, obj);
+    Eterm *hp = heap_alloc(heap, term_size(key));
+    return copy_term(key, &hp);
+}
+
+// the node's own copy of the key, no node lock needed
+static Eterm skip_key_to_heap(const SkipNode *n, Heap *heap) {
+    Eterm *hp = heap_alloc(heap, term_size(n->key));
+    return copy_term(n->key, &hp);
+}
+
+// first key in bucket order starting at bucket index from
+static int hash_first_from(EtsTable *t, usize from, Heap *heap, Eterm *key_out) {
+    for (usize i = from;; i++) {
+        EtsLock *l = &t->locks[i & (t->lock_count - 1)];
+        lock_read(t, l);
+        if (i >= t->bucket_count) {
+            unlock(t, l);
+            return 0;
+        }
+        DbObject *obj = t->buckets[i];
+        if (obj) *key_out = key_to_heap(t, obj, heap);
+        unlock(t, l);
+        if (obj) return 1;
+    }
+}
+
+int ets_first(EtsTable *t, Heap *heap, Eterm *key_out) {
+    if (t->type == ETS_ORDERED_SET) {
+        lock_read(t, &t->tree_lock);
+        SkipNode *n = next_node(t->head, 0);
+        if (n) *key_out = skip_key_to_heap(n, heap);
+        unlock(t, &t->tree_lock);
+        return n != NULL;
+    }
+    return hash_first_from(t, 0, heap, key_out);
+}
+
+int ets_next(EtsTable *t, Eterm key, Heap *heap, Eterm *key_out) {
+    if (t->type == ETS_ORDERED_SET) {
+        lock_read(t, &t->tree_lock);
+        SkipNode *n = skip_search(t, key, NULL, NULL);
+        // skip_search stops at the first key >= key, we want the first > key
+        while (n && term_cmp(n->key, key) == 0) n = next_node(n, 0);
+        if (n) *key_out = skip_key_to_heap(n, heap);
+        unlock(t, &t->tree_lock);
+        return n != NULL;
+    }
+
+    Uint64 hash = term_hash(key);
+    EtsLock *l = bucket_lock(t, hash);
+    usize index;
+
+    lock_read(t, l);
+    index = hash & (t->bucket_count - 1);
+    DbObject *obj = hash_find(t, key, hash);
+    // step over the remaining objects with this key (bag)
+    while (obj && obj->hash == hash && term_eq(object_key(t, obj), key)) obj = obj->next;
+    if (obj) *key_out = key_to_heap(t, obj, heap);
+    unlock(t, l);
+
+    if (obj) return 1;
+    return hash_first_from(t, index + 1, heap, key_out);
+}
+
+usize ets_size(EtsTable *t) {
+    return atomic_load(&t->size);
+}
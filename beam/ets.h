@@ -0,0 +1,64 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "binary_parsing_helpers.h"
+#include "term.h"
+#include "heap.h"
+
+/*
+Shared term tables (ETS).
+
+Tables are shared by every process and every scheduler thread. Stored
+objects are copied out of the caller's heap into memory owned by the table,
+and copied back onto the caller's heap on lookup, so no process ever holds a
+pointer into a table.
+
+set / bag:    hash table, buckets are guarded by striped locks
+ordered_set:  skiplist ordered by the standard term order. Lookups and
+              traversal walk it without locking nodes. With
+              ETS_WRITE_CONCURRENCY inserts and update_counter lock only the
+              nodes they change, so writers to different keys run in
+              parallel with each other and with readers; delete still
+              locks the whole table, since it frees the node.
+*/
+typedef enum {
+    ETS_SET,
+    ETS_ORDERED_SET,
+    ETS_BAG
+} EtsType;
+
+// options for ets_new
+#define ETS_READ_CONCURRENCY  0x1   // readers do not block each other
+#define ETS_WRITE_CONCURRENCY 0x2   // writers to different keys do not block each other
+#define ETS_NAMED_TABLE       0x4   // table can be found with ets_whereis
+
+typedef struct ets_table EtsTable;
+
+// keypos is 1-based like in Erlang; returns NULL if a named table already exists
+EtsTable *ets_new(Eterm name, EtsType type, int keypos, int flags);
+void ets_delete_table(EtsTable *t);
+EtsTable *ets_whereis(Eterm name);
+
+// every function below returns 1 on success and 0 on badarg
+
+// inserts a copy of tuple, replacing an object with the same key (set, ordered_set)
+int ets_insert(EtsTable *t, Eterm tuple);
+// stores the list of objects with the given key, built on heap, in out
+int ets_lookup(EtsTable *t, Eterm key, Heap *heap, Eterm *out);
+int ets_member(EtsTable *t, Eterm key);
+int ets_delete(EtsTable *t, Eterm key);
+
+/*
+Atomically adds the integer incr to element pos of the object with key and
+stores the new value, built on heap, in result. Counters become bignums
+when they leave the small range, like in Erlang.
+*/
+int ets_update_counter(EtsTable *t, Eterm key, int pos, Eterm incr, Heap *heap, Eterm *result);
+
+// traversal, keys are copied onto heap; return 0 at the end of the table
+int ets_first(EtsTable *t, Heap *heap, Eterm *key_out);
+int ets_next(EtsTable *t, Eterm key, Heap *heap, Eterm *key_out);
+
+usize ets_size(EtsTable *t);
@@ -0,0 +1,136 @@
+/*
+Fuzz harness for the loader: every input goes through walk_file(), which
+parses the chunks and validates the code, then the module is freed.
+
+Built with -DBEAM_FUZZ=ON. With clang it is a libFuzzer target:
+    ./fuzz_walk_file corpus_dir
+Otherwise (gcc has no libFuzzer) FUZZ_STANDALONE adds a main that runs each
+file given on the command line, then random mutations of it (bit flips,
+interesting bytes, truncation, copied blocks). The input being run is kept
+in fuzz-current.beam, after a sanitizer report that file reproduces it:
+    ./fuzz_walk_file [-n mutations] [-s seed] file.beam...
+*/
+#include "load.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    BeamModule *bm = calloc(1, sizeof(BeamModule));
+    if (!bm) {
+        perror("calloc failed");
+        exit(1);
+    }
+    walk_file(bm, data, size);
+    free_module(bm);
+    return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+
+static Uint64 next_rand(Uint64 *s) {
+    Uint64 x = *s;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *s = x;
+    return x;
+}
+
+static void mutate(byte *buf, usize *size, usize max_size, Uint64 *seed) {
+    static const byte interesting[] = { 0x00, 0x01, 0x7f, 0x80, 0xf8, 0xff };
+    int rounds = 1 + next_rand(seed) % 4;
+    for (int i = 0; i < rounds && *size > 0; i++) {
+        usize at = next_rand(seed) % *size;
+        switch (next_rand(seed) % 16) {
+        case 0:
+        case 1:
+        case 2:
+        case 3:
+        case 4:
+        case 5:
+            buf[at] ^= (byte)(1 << (next_rand(seed) % 8));
+            break;
+        case 6:
+        case 7:
+        case 8:
+        case 9:
+        case 10:
+            buf[at] = interesting[next_rand(seed) % sizeof interesting];
+            break;
+        case 11:
+            // rare, almost every truncated file fails the header check
+            *size = at;
+            break;
+        default: {
+            // copy a block over another place, keeps the file structure but mixes operands
+            usize from = next_rand(seed) % *size;
+            usize len = 1 + next_rand(seed) % 16;
+            if (from + len > *size) len = *size - from;
+            if (at + len > max_size) len = max_size - at;
+            memmove(buf + at, buf + from, len);
+            if (at + len > *size) *size = at + len;
+            break;
+        }
+        }
+    }
+}
+
+static void run(const byte *data, usize size) {
+    // keep the input on disk first, a crash leaves the reproducer behind
+    FILE *f = fopen("fuzz-current.beam", "wb");
+    if (f) {
+        fwrite(data, 1, size, f);
+        fclose(f);
+    }
+    LLVMFuzzerTestOneInput(data, size);
+}
+
+int main(int argc, char **argv) {
+    usize mutations = 10000;
+    Uint64 seed = 0x9e3779b97f4a7c15ULL;
+    int first = 1;
+    for (; first < argc && argv[first][0] == '-'; first += 2) {
+        if (first + 1 >= argc) break;
+        if (strcmp(argv[first], "-n") == 0) mutations = (usize)strtoull(argv[first + 1], NULL, 10);
+        else if (strcmp(argv[first], "-s") == 0) seed = strtoull(argv[first + 1], NULL, 0) | 1;
+    }
+    if (first >= argc) {
+        fprintf(stderr, "usage: %s [-n mutations] [-s seed] file.beam...\n", argv[0]);
+        return 1;
+    }
+
+    for (int i = first; i < argc; i++) {
+        byte *orig;
+        usize orig_size;
+        if (load_file(argv[i], &orig, &orig_size) != 0) {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 1;
+        }
+        byte *buf = malloc(orig_size ? orig_size : 1);
+        if (!buf) {
+            perror("malloc failed");
+            exit(1);
+        }
+
+        run(orig, orig_size);
+        for (usize n = 0; n < mutations; n++) {
+            usize size = orig_size;
+            memcpy(buf, orig, orig_size);
+            mutate(buf, &size, orig_size, &seed);
+            // an exact sized copy, so reads past the end are caught
+            byte *input = malloc(size ? size : 1);
+            if (!input) {
+                perror("malloc failed");
+                exit(1);
+            }
+            memcpy(input, buf, size);
+            run(input, size);
+            free(input);
+        }
+        fprintf(stderr, "%s: %zu mutations done\n", argv[i], mutations);
+        free(buf);
+        free(orig);
+    }
+    remove("fuzz-current.beam");
+    return 0;
+}
+
+#endif
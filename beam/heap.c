@@ -0,0 +1,86 @@
+#include "heap.h"
+
+static HeapFragment *new_fragment(usize words) {
+    HeapFragment *f = malloc(sizeof(HeapFragment) + words * sizeof(Eterm));
+    if (!f) {
+        perror("malloc failed");
+        exit(1);
+    }
+    f->next = NULL;
+    f->size = words;
+    f->used = 0;
+    return f;
+}
+
+void heap_init(Heap *h, usize initial_words) {
+    h->frags = NULL;
+    h->min_size = initial_words ? initial_words : HEAP_DEFAULT_SIZE;
+}
+
+Eterm *heap_alloc(Heap *h, usize words) {
+    HeapFragment *f = h->frags;
+
+    if (!f || f->size - f->used < words) {
+        usize size = f ? f->size * 2 : h->min_size;
+        if (size < words) size = words;
+
+        HeapFragment *nf = new_fragment(size);
+        nf->next = f;
+        h->frags = nf;
+        f = nf;
+    }
+
+    Eterm *hp = f->mem + f->used;
+    f->used += words;
+    return hp;
+}
+
+void heap_reset(Heap *h) {
+    HeapFragment *f = h->frags;
+    if (!f) return;
+
+    HeapFragment *rest = f->next;
+    while (rest) {
+        HeapFragment *next = rest->next;
+        free(rest);
+        rest = next;
+    }
+    f->next = NULL;
+    f->used = 0;
+}
+
+void heap_shrink(Heap *h) {
+    HeapFragment *keep = NULL;
+    HeapFragment *f = h->frags;
+    while (f) {
+        HeapFragment *next = f->next;
+        if (!keep && f->size == h->min_size) {
+            keep = f;
+        } else {
+            free(f);
+        }
+        f = next;
+    }
+    if (!keep) keep = new_fragment(h->min_size);
+    keep->next = NULL;
+    keep->used = 0;
+    h->frags = keep;
+}
+
+void heap_free(Heap *h) {
+    HeapFragment *f = h->frags;
+    while (f) {
+        HeapFragment *next = f->next;
+        free(f);
+        f = next;
+    }
+    h->frags = NULL;
+}
+
+usize heap_used(const Heap *h) {
+    usize n = 0;
+    for (const HeapFragment *f = h->frags; f; f = f->next) {
+        n += f->used;
+    }
+    return n;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "binary_parsing_helpers.h"
+#include "term.h"
+
+/*
+A term heap made of fragments. Allocation bumps the top of the newest
+fragment; when it is full a new (at least twice as large) fragment is
+chained in front. Terms never move, so there is no garbage collection:
+a heap is either reset as a whole or freed.
+*/
+typedef struct heap_fragment {
+    struct heap_fragment *next;
+    usize size;     // words in mem
+    usize used;     // words handed out
+    Eterm mem[];
+} HeapFragment;
+
+typedef struct {
+    HeapFragment *frags;
+    usize min_size;
+} Heap;
+
+#define HEAP_DEFAULT_SIZE 256
+
+void heap_init(Heap *h, usize initial_words);
+// reserves words on the heap, never fails (exits on out of memory)
+Eterm *heap_alloc(Heap *h, usize words);
+// drops every term but keeps the newest fragment for reuse
+void heap_reset(Heap *h);
+// drops every term and every fragment but one of the initial size, allocates that one if needed
+void heap_shrink(Heap *h);
+void heap_free(Heap *h);
+// words in use over all fragments
+usize heap_used(const Heap *h);
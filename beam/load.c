@@ -1,72 +1,118 @@
+#include <zlib.h>
 #include "load.h"
 #include "binary_parsing_helpers.h"
+#include "validate.h"
 
 int load(char **argv) {
     BeamModule *beam_module = calloc(1, sizeof(BeamModule));;
     byte *buf;
     usize size;
 
+    if (!beam_module) {
+        perror("calloc failed");
+        exit(1);
+    }
     if (load_file(argv[1], &buf, &size) != 0) {
         printf("File load error\n");
-        return 1;
+        free(beam_module);
+        return 0;
     }
 
     int ok = walk_file(beam_module, buf, size);
     free(buf);
 
-    printf("########## Loaded Module ##########\n");
-    print_module_name(beam_module);
-    print_atoms(beam_module);
-    print_exports(beam_module);
-    print_imports(beam_module);
-    printf("########## Loaded Module ##########\n");
+    if (ok) {
+        printf("########## Loaded Module ##########\n");
+        print_module_name(beam_module);
+        print_atoms(beam_module);
+        print_exports(beam_module);
+        print_imports(beam_module);
+        print_literals(beam_module);
+        print_code(stdout, &beam_module->code);
+        printf("########## Loaded Module ##########\n");
+    } else {
+        fprintf(stderr, "Rejected %s\n", argv[1]);
+    }
 
-    free(beam_module);
-    return ok ? 0 : 1;
+    free_module(beam_module);
+    return ok;
 }
 
+/*
+LitT layout:
+4 bytes: uncompressed size (0 = the rest is not compressed)
+rest:    zlib compressed (or plain) literal table
+
+literal table:
+4 bytes: literal count
+per literal: 4 bytes size, then the term in external term format
+*/
 int parse_literal_chunk(BeamModule *bm, const byte *chunk_data, Uint32 chunk_size) {
-    if (chunk_size < 4) return 0;
+    Uint32 uncompressed_size;
+    if (!read_be32(chunk_data, chunk_size, &uncompressed_size)) return 0;
 
-    Uint32 count;
-    read_be32(chunk_data, chunk_size, &count);
-    printf("%u literals\n", count);
+    const byte *data = chunk_data + 4;
+    usize data_size = chunk_size - 4;
+    byte *inflated = NULL;
 
-    if (chunk_size < 4 + 4*count) return 0;
+    if (uncompressed_size != 0) {
+        // deflate cannot compress better than about 1032:1, refuse sizes that only a corrupt file has
+        if (uncompressed_size / 1032 > data_size + 1) {
+            fprintf(stderr, "Bad literal chunk size %u\n", uncompressed_size);
+            return 0;
+        }
+        inflated = malloc(uncompressed_size);
+        if (!inflated) {
+            perror("malloc failed");
+            exit(1);
+        }
+        uLongf inflated_size = uncompressed_size;
+        if (uncompress(inflated, &inflated_size, data, data_size) != Z_OK || inflated_size != uncompressed_size) {
+            fprintf(stderr, "Failed inflating literal chunk\n");
+            free(inflated);
+            return 0;
+        }
+        data = inflated;
+        data_size = uncompressed_size;
+    }
 
-    Uint32 *offsets = malloc(sizeof(Uint32) * count);
-    if (!offsets) return 0;
+    Reader r;
+    reader_init(&r, data, data_size);
 
-    for (Uint32 i = 0; i < count; i++) {
-        read_be32(chunk_data + 4 + i*4, chunk_size - 4 - i*4, &offsets[i]);
+    Sint32 count;
+    // every literal takes at least its 4 byte size
+    if (!reader_read_i32(&r, &count) || count < 0 || (usize)count > reader_remaining(&r) / 4) {
+        fprintf(stderr, "Failed reading literal count\n");
+        free(inflated);
+        return 0;
     }
 
-    const byte *data = chunk_data + 4 + 4*count;
-
-    for (Uint32 i = 0; i < count; i++) {
-        const byte *lit = data + offsets[i];
+    heap_init(&bm->literal_heap, 0);
+    bm->literals = calloc((usize)count + 1, sizeof(Eterm));
+    if (!bm->literals) {
+        perror("calloc failed");
+        exit(1);
+    }
 
-        // Each literal is an Erlang Term Format (ETF) term
-        if (lit[0] != 131) {
-            printf("Skipping literal %u: not ETF version 131\n", i);
-            continue;
+    for (Sint32 i = 0; i < count; i++) {
+        Sint32 size;
+        const byte *term;
+        if (!reader_read_i32(&r, &size) || size < 0 || !reader_read_bytes(&r, &term, (usize)size)) {
+            fprintf(stderr, "Literal %d truncated\n", i);
+            free(inflated);
+            return 0;
         }
 
-        byte tag = lit[1];
-        if (tag == 109) { // BINARY_EXT
-            Uint32 len;
-            read_be32(lit + 2, 4, &len);
-            const byte *str = lit + 6;
-            printf("Literal %u (string): %.*s\n", i, len, str);
-        } else if (tag == 108) { // LIST_EXT
-            // optionally decode lists if you want
-            printf("Literal %u is a list, skipping for now\n", i);
-        } else {
-            printf("Literal %u: unhandled tag %u\n", i, tag);
+        // Each literal is an Erlang Term Format (ETF) term
+        if (!etf_decode(term, (usize)size, &bm->literal_heap, &bm->literals[i])) {
+            fprintf(stderr, "Failed decoding literal %d\n", i);
+            free(inflated);
+            return 0;
         }
+        bm->literal_count++;
     }
 
-    free(offsets);
+    free(inflated);
     return 1;
 }
 
@@ -76,42 +122,44 @@ int parse_export_chunk(BeamModule *bm, const byte *chunk_data, Uint32 chunk_size
     reader_init(&r, chunk_data, chunk_size);
 
     Sint32 count;
-    if(!reader_read_i32(&r, &count)) {
+    // every export takes 12 bytes
+    if(!reader_read_i32(&r, &count) || count < 0 || (usize)count > reader_remaining(&r) / 12) {
         fprintf(stderr, "Failed reading export count\n");
         return 0;
     }
 
     for (size_t i = 1; i <= (size_t)count; ++i) {
-        Uint32 name_idx;
-        Uint32 arity;
-        Uint32 label;
+        Sint32 name_idx;
+        Sint32 arity;
+        Sint32 label;
         // Read name atom index
         if (!reader_read_i32(&r, &name_idx)) {
-            fprintf(stderr, "Failed reading name index for export %d\n", i);
+            fprintf(stderr, "Failed reading name index for export %zu\n", i);
             return 0;
         }
 
         if (!reader_read_i32(&r, &arity)) {
-            fprintf(stderr, "Failed reading arity index for export %d\n", i);
+            fprintf(stderr, "Failed reading arity index for export %zu\n", i);
             return 0;
         }
 
         if (!reader_read_i32(&r, &label)) {
-            fprintf(stderr, "Failed reading label for export %d\n", i);
+            fprintf(stderr, "Failed reading label for export %zu\n", i);
             return 0;
         }
 
         // resolve name_idx into string
         const char *name = NULL;
 
-        if (name_idx - 1 < bm->atom_count) {
+        if (name_idx >= 1 && name_idx <= bm->atom_count) {
             name = bm->atom_table[name_idx - 1].value;
         } else {
-            name = "(invalid atom index)";
+            fprintf(stderr, "Invalid atom index %d for export %zu\n", name_idx, i);
+            return 0;
         }
 
         size_t length = strlen(name);
-        add_export_to_module(bm, name, length, arity, label);
+        add_export_to_module(bm, (const byte *)name, length, arity, label);
         //printf("  %s |  arity%u | (label=%u)\n", name, arity, label);
     }
     return 1;
@@ -121,13 +169,17 @@ int parse_import_chunk(BeamModule *bm, const byte *chunk_data, Uint32 chunk_size
     Reader r;
     reader_init(&r, chunk_data, chunk_size);
 
-    Uint32 count;
-    reader_read_i32(&r, &count);
+    Sint32 count;
+    // every import takes 12 bytes
+    if (!reader_read_i32(&r, &count) || count < 0 || (usize)count > reader_remaining(&r) / 12) {
+        fprintf(stderr, "Failed reading import count\n");
+        return 0;
+    }
 
-    for(int i = 1; i <= (size_t)count; i++) {
-        Uint32 module_name_idx;
-        Uint32 function_name_idx;
-        Uint32 arity;
+    for(int i = 1; i <= count; i++) {
+        Sint32 module_name_idx;
+        Sint32 function_name_idx;
+        Sint32 arity;
         // Read name atom index
         if (!reader_read_i32(&r, &module_name_idx)) {
             fprintf(stderr, "Failed reading name index for export %d\n", i);
@@ -147,22 +199,19 @@ int parse_import_chunk(BeamModule *bm, const byte *chunk_data, Uint32 chunk_size
         const char *module_name = NULL;
         const char *function_name = NULL;
 
-        if (module_name_idx - 1 < bm->atom_count) {
-            module_name = bm->atom_table[module_name_idx - 1].value;
-        } else {
-            module_name = "(invalid atom index)";
-        }
-
-        if (function_name_idx - 1 < bm->atom_count) {
-            function_name = bm->atom_table[function_name_idx - 1].value;
-        } else {
-            function_name = "(invalid atom index)";
+        if (module_name_idx < 1 || module_name_idx > bm->atom_count ||
+            function_name_idx < 1 || function_name_idx > bm->atom_count) {
+            fprintf(stderr, "Invalid atom index for import %d\n", i);
+            return 0;
         }
+        module_name = bm->atom_table[module_name_idx - 1].value;
+        function_name = bm->atom_table[function_name_idx - 1].value;
 
         usize module_name_len = strlen(module_name);
         usize function_name_len = strlen(function_name);
 
-        add_import_to_module(bm, module_name, module_name_len, function_name, function_name_len, arity);
+        add_import_to_module(bm, (const byte *)module_name, module_name_len, (const byte *)function_name,
+                             function_name_len, arity);
     }
     return 1;
 }
@@ -184,10 +233,15 @@ int parse_atom_chunk(BeamModule *bm, const byte *chunk_data, Uint32 chunk_size)
     // if not we just use count
     int long_counts = 0;
     Sint32 count = count_signed;
-    if (count < 0) {
+    if (count < 0 && count != INT32_MIN) {
         long_counts = 1;
         count = -count;
     }
+    // the module name comes first, every atom takes at least one byte
+    if (count < 1 || (usize)count > reader_remaining(&r)) {
+        fprintf(stderr, "Bad atom count %d\n", count_signed);
+        return 0;
+    }
 
     /*
     What it does: Computes atoms_count = count + 1, stored as size_t.
@@ -227,6 +281,10 @@ int parse_atom_chunk(BeamModule *bm, const byte *chunk_data, Uint32 chunk_size)
             fprintf(stderr, "Atom data truncated for atom %zu\n", i);
             return 0;
         }
+        if (length > MAX_ATOM_BYTES) {
+            fprintf(stderr, "Atom %zu is too long\n", i);
+            return 0;
+        }
 
         // will be a pointer to the start of the atom name bytes inside the chunk buffer
         const byte *s;
@@ -235,64 +293,44 @@ int parse_atom_chunk(BeamModule *bm, const byte *chunk_data, Uint32 chunk_size)
         /* print atom (may be UTF-8) */
         //printf("  %zu: %.*s\n", i, (int)length, (const char*)s);
 
+        // atom i is atom_table[i - 1], the first one is also the module name
         if(i == 1) {
             add_name_to_module(bm, (const char*)s, (int)length);
         }
-        else {
-            add_atom_to_module(bm, (const char*)s, (int)length);
-        }
+        add_atom_to_module(bm, (const char*)s, (int)length);
     }
     return 1;
 }
 
 int parse_header(const byte *buf, usize buf_size, Uint32 *total_size) {
-    const byte *p = buf; 
-
-    char header[5];
-    char beam[5];
-
-    memcpy(header, p, 4); header[4] = 0;
-    read_be32(buf + 4, buf_size - 4, total_size);
-    memcpy(beam, p + 8, 4); beam[4] = 0;
+    if (buf_size < 12 || memcmp(buf, "FOR1", 4) != 0 || memcmp(buf + 8, "BEAM", 4) != 0) {
+        fprintf(stderr, "Not a BEAM file\n");
+        return 0;
+    }
 
-    printf("######BEAM HEADER#######\n");
-    printf("%s\n", header);
-    printf("%" PRIu32 "\n", total_size);
-    printf("%s\n", beam);
-    printf("########################\n");
+    // the size counts everything after the size field, "BEAM" included
+    if (!read_be32(buf + 4, buf_size - 4, total_size) || *total_size < 4 || *total_size > buf_size - 8) {
+        fprintf(stderr, "BEAM file truncated\n");
+        return 0;
+    }
 
     return 1;
 }
 
-/* Walk chunk table and find AtU8/Atom */
+/* Walk chunk table and parse the chunks we know, returns 1 if the module is valid */
 int walk_file(BeamModule *bm, const byte *buf, usize buf_size) {
-    if (memcmp(buf, "FOR1", 4) != 0) return 0;
-
     // declare a 32-bit unsigned variable to store the total BEAM payload size.
     Uint32 total_size;
 
-    // parse header reads the total_size and stores it in total_size
-    parse_header(buf, buf_size, &total_size);
-
     /*
-    Reads the 32-bit big-endian size after "FOR1"
-
     BEAM format:
     0–3: "FOR1"
-    4–7: File sizeafter this header (big-endian)
+    4–7: File size after this field (big-endian)
     8–11: "BEAM"
 
-    So this reads the 4 bytes starting at buf + 4 into total_size.
-
-    No error check here — the parser assumes valid input.
-    */
-    //read_be32(buf + 4, buf_size - 4, &total_size);
-
-    /*
-    Checks bytes 8–11 for the literal "BEAM".
-    If missing → Not a valid BEAM file → return failure.
+    parse_header checks the magic values and that the file holds total_size bytes.
     */
-    if (memcmp(buf + 8, "BEAM", 4) != 0) return 0;
+    if (!parse_header(buf, buf_size, &total_size)) return 0;
 
     /*
     Initializes the chunk table scanning pointers
@@ -305,7 +343,8 @@ int walk_file(BeamModule *bm, const byte *buf, usize buf_size) {
     end points to the end of all chunks, so we don’t read past file contents
     */
     const byte *p = buf + 12;
-    const byte *end = buf + 12 + total_size;
+    const byte *end = buf + 8 + total_size;
+    int have_atoms = 0, have_exports = 0, have_imports = 0, have_code = 0, have_literals = 0;
 
     /*
     Each chunk header is:
@@ -313,17 +352,11 @@ int walk_file(BeamModule *bm, const byte *buf, usize buf_size) {
     4 bytes: chunk size
     So a minimum of 8 bytes must be available.
     */
-    while (p + 8 <= end) {
+    while (end - p >= 8) {
         /*
         Read chunk ID (e.g., "Atom", "Code", "StrT")
         The chunk name is 4 ASCII characters.
         Copy them into a 5-byte buffer and terminate with \0 for string comparison.
-        Example ID strings you may see:
-        "Atom"
-        "AtU8"
-        "Code"
-        "ExpT"
-        "StrT"
         */
         char id[5];
         memcpy(id, p, 4); id[4] = 0;
@@ -331,56 +364,166 @@ int walk_file(BeamModule *bm, const byte *buf, usize buf_size) {
         /*
         Read the chunk size (big-endian)
         p + 4 points to the 4-byte size field just after the ID.
-        size = number of bytes in the chunk data.
+        size = number of bytes in the chunk data, which must lie inside the file.
         */
         Uint32 size;
-        read_be32(p + 4, end - p - 4, &size);
+        if (!read_be32(p + 4, end - p - 4, &size) || size > (usize)(end - p - 8)) {
+            fprintf(stderr, "Chunk %s truncated\n", id);
+            return 0;
+        }
 
-        // Set pointer to the chunk data
         // This points to the first byte of the chunk contents.
         const byte *chunk = p + 8;
+        int ok = 1;
 
         /*
-        Found an Atom chunk — parse and exit
+        Each chunk we parse may appear only once, a second copy would replace
+        (and leak) what the first one loaded.
         Elixir modules typically use "AtU8".
-        If the current chunk is one of the atom table chunks:
-        Print which one we found
-        Immediately call parse_atom_chunk(...)
-        Immediately return its result
-        This stops scanning further chunks because we only want atoms.
         */
-        if (strcmp(id, "AtU8") == 0 || strcmp(id, "Atom") == 0 || strcmp(id, "AtomUTF8") == 0) {
-            parse_atom_chunk(bm, chunk, size);
+        if (strcmp(id, "AtU8") == 0 || strcmp(id, "Atom") == 0) {
+            ok = !have_atoms++ && parse_atom_chunk(bm, chunk, size);
         }
         else if(strcmp(id, "ExpT") == 0) {
-            parse_export_chunk(bm, chunk, size);
+            ok = !have_exports++ && parse_export_chunk(bm, chunk, size);
         }
         else if(strcmp(id, "ImpT") == 0) {
-            parse_import_chunk(bm, chunk, size);
+            ok = !have_imports++ && parse_import_chunk(bm, chunk, size);
         }
         else if(strcmp(id, "Code") == 0) {
-            printf("found code chunk %s\n", id);
+            ok = !have_code++ && parse_code(&bm->code, chunk, size);
         }
         else if(strcmp(id, "LitT") == 0) {
-            parse_literal_chunk(bm, chunk, size);
+            ok = !have_literals++ && parse_literal_chunk(bm, chunk, size);
         }
-        else {
-            printf("%s\n", id);
+        // any other chunk is skipped
+        if (!ok) {
+            fprintf(stderr, "Bad %s chunk\n", id);
+            return 0;
         }
+
         /*
         Move to the next chunk
         BEAM chunks are padded to 4-byte alignment.
         8 bytes = ID + size header
         align4(size) gives the padded size of the chunk data
-        Add them together to jump to the next chunk header
-
-        Example:
-        If a chunk has size = 5, it will be padded to 8:
-        actual data length = 5 → padded length = 8
+        The last chunk may come without its padding.
         */
+        if ((usize)(end - p) <= 8 + (usize)align4(size)) break;
         p += 8 + align4(size);
     }
-    return 0;
+
+    if (!have_atoms || !have_code) {
+        fprintf(stderr, "Module has no %s chunk\n", have_atoms ? "Code" : "atom");
+        return 0;
+    }
+
+    // the validator and the map key sorting need all chunks
+    if (!validate_module(bm)) return 0;
+    prepare_map_instructions(bm);
+    return 1;
+}
+
+void free_module(BeamModule *bm) {
+    for (int i = 0; i < bm->atom_count; i++) free(bm->atom_table[i].value);
+    free(bm->atom_table);
+    for (int i = 0; i < bm->export_count; i++) free(bm->exports[i].name);
+    free(bm->exports);
+    for (int i = 0; i < bm->import_count; i++) {
+        free(bm->imports[i].module_name);
+        free(bm->imports[i].function_name);
+    }
+    free(bm->imports);
+    free(bm->module_name);
+    free_code(&bm->code);
+    heap_free(&bm->literal_heap);
+    free(bm->literals);
+    free(bm);
+}
+
+int operand_term(const BeamModule *bm, const Operand *o, Eterm *out) {
+    switch (o->type) {
+    case OPERAND_ATOM:
+        if (o->val == 0) {
+            *out = NIL;
+        } else if (o->val <= bm->atom_count) {
+            *out = make_atom(bm->atom_table[o->val - 1].global_index);
+        } else {
+            return 0;
+        }
+        return 1;
+    case OPERAND_I:
+    case OPERAND_CHAR:
+        *out = make_small(o->val);
+        return 1;
+    case OPERAND_BIG:
+        *out = (Eterm)o->val;
+        return 1;
+    case OPERAND_LITERAL:
+        if (o->val >= bm->literal_count) return 0;
+        *out = bm->literals[o->val];
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/*
+get_map_elements Fail Src [Key Dst ...]
+has_map_fields   Fail Src [Key ...]
+put_map_assoc    Fail Src Dst Live [Key Value ...]
+put_map_exact    Fail Src Dst Live [Key Value ...]
+Lists whose keys are all constants are put in map key order, which is the
+order of the keys of a flatmap.
+*/
+static void sort_key_list(BeamModule *bm, const Operand *list, usize stride) {
+    usize n = list->len / stride;
+    Operand *ops = &bm->code.operands[list->val];
+    if (n < 2) return;
+
+    // key and original position of every entry
+    Eterm *keys = malloc(2 * n * sizeof(Eterm));
+    Operand *sorted = malloc(list->len * sizeof(Operand));
+    if (!keys || !sorted) {
+        perror("malloc failed");
+        exit(1);
+    }
+
+    usize i;
+    for (i = 0; i < n; i++) {
+        if (!operand_term(bm, &ops[i * stride], &keys[2 * i])) break;
+        keys[2 * i + 1] = make_small(i);
+    }
+    if (i == n) {
+        map_sort_pairs(keys, n, 2);
+        for (i = 0; i < n; i++) {
+            usize from = (usize)small_value(keys[2 * i + 1]);
+            memcpy(&sorted[i * stride], &ops[from * stride], stride * sizeof(Operand));
+        }
+        memcpy(ops, sorted, list->len * sizeof(Operand));
+    }
+    free(sorted);
+    free(keys);
+}
+
+void prepare_map_instructions(BeamModule *bm) {
+    BeamCode *code = &bm->code;
+
+    for (usize i = 0; i < code->instr_count; i++) {
+        const Instr *in = &code->instrs[i];
+        int list_arg, stride;
+
+        switch (in->op) {
+        case op_get_map_elements: list_arg = 2; stride = 2; break;
+        case op_has_map_fields:   list_arg = 2; stride = 1; break;
+        case op_put_map_assoc:
+        case op_put_map_exact:    list_arg = 4; stride = 2; break;
+        default: continue;
+        }
+
+        const Operand *list = instr_arg(code, in, list_arg);
+        if (list->type == OPERAND_LIST) sort_key_list(bm, list, stride);
+    }
 }
 
 int add_name_to_module(BeamModule *bm, const char *name, usize len) {
@@ -392,6 +535,7 @@ int add_name_to_module(BeamModule *bm, const char *name, usize len) {
 
 int print_module_name(BeamModule *bm) {
     printf("MODULE NAME: %s\n", bm->module_name);
+    return 1;
 }
 
 int add_atom_to_module(BeamModule *bm, const char *atom, usize len) {
@@ -408,6 +552,7 @@ int add_atom_to_module(BeamModule *bm, const char *atom, usize len) {
     a->value = malloc(a->size + 1);
     memcpy(a->value, atom, len);
     a->value[len] = '\0';
+    a->global_index = atom_put(atom, len);
 
     bm->atom_count++;
 
@@ -465,6 +610,16 @@ int print_atoms(BeamModule *bm) {
     return 1;
 }
 
+int print_literals(BeamModule *bm) {
+    printf("%d literals\n", bm->literal_count);
+    for (int i = 0; i < bm->literal_count; i++) {
+        printf("Literal %d: ", i);
+        print_term(stdout, bm->literals[i]);
+        printf("\n");
+    }
+    return 1;
+}
+
 int print_exports(BeamModule *bm) {
     for(int i = 0; i < bm->export_count; i++) {
         printf("ExpT %d: name=%s, arity=%u, label=%u\n", 
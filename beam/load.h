@@ -6,11 +6,20 @@
 #include <errno.h>
 #include <inttypes.h>
 #include "binary_parsing_helpers.h"
+#include "atom.h"
+#include "code.h"
+#include "heap.h"
+#include "etf.h"
+#include "map.h"
+
+// 255 characters of up to 4 bytes
+#define MAX_ATOM_BYTES 1020
 
 typedef struct {
     int index;
-    uint8_t size;
+    Uint16 size;
     char *value;
+    Uint32 global_index; // id in the global atom table (atom.h)
 } Atom;
 
 typedef struct {
@@ -36,12 +45,21 @@ typedef struct beam_module {
 
     ImpT* imports;
     int import_count;
+
+    BeamCode code;
+
+    // decoded LitT terms, live on literal_heap
+    Eterm *literals;
+    int literal_count;
+    Heap literal_heap;
 } BeamModule;
 
-// loads the whole file in memory and calls the walk_file method on it
+// loads the whole file in memory and calls the walk_file method on it, returns 1 if the module loaded
 int load(char **argv);
-/* Walk chunk table and find AtU8/Atom */
+/* Walk chunk table, parse and validate the module quietly (errors go to stderr). Returns 0 for malformed files */
 int walk_file(BeamModule *bm, const byte *buf, usize buf_size);
+// frees everything walk_file allocated and bm itself
+void free_module(BeamModule *bm);
 // header part
 int parse_header(const byte *buf, usize buf_size, Uint32 *total_size); 
 int add_name_to_module(BeamModule *bm, const char *name, usize len);
@@ -64,4 +82,10 @@ int add_import_to_module(BeamModule *bm, const byte *module_name, usize module_n
 int print_imports(BeamModule *bm);
 
 // string chunk
-int parse_literal_chunk(BeamModule *bm, const byte *chunk_data, Uint32 chunk_size);
\ No newline at end of file
+int parse_literal_chunk(BeamModule *bm, const byte *chunk_data, Uint32 chunk_size);
+int print_literals(BeamModule *bm);
+
+// constant operand (atom, integer, char, literal) as a term, returns 0 for anything else
+int operand_term(const BeamModule *bm, const Operand *o, Eterm *out);
+// sorts the constant key lists of the map instructions so the map fast paths can walk them in order
+void prepare_map_instructions(BeamModule *bm);
\ No newline at end of file
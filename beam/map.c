@@ -0,0 +1,568 @@
+#include "map.h"
+
+#define HAMT_MASK ((1u << HAMT_BITS) - 1)
+
+// words before the children of a root, inner or collision node
+#define ROOT_PREFIX       3
+#define NODE_PREFIX       2
+#define COLLISION_PREFIX  1
+
+// shared by every empty map
+static Eterm empty_keys[1] = { make_tuple_header(0) };
+
+static Uint32 hamt_index(Uint64 hash, int depth) {
+    return (Uint32)(hash >> (HAMT_BITS * depth)) & HAMT_MASK;
+}
+
+static Eterm make_flatmap(Heap *heap, Eterm keys, const Eterm *values, usize n) {
+    Eterm *hp = heap_alloc(heap, 2 + n);
+    hp[0] = make_header(1 + n, SUBTAG_FLATMAP);
+    hp[1] = keys;
+    if (n) memcpy(hp + 2, values, n * sizeof(Eterm));
+    return make_boxed(hp);
+}
+
+static Eterm make_leaf(Heap *heap, Eterm key, Eterm value) {
+    Eterm *hp = heap_alloc(heap, 2);
+    return make_cons(&hp, key, value);
+}
+
+Eterm map_new(Heap *heap) {
+    return make_flatmap(heap, make_boxed(empty_keys), NULL, 0);
+}
+
+/*
+Stable sort of (key, ...) records by key. qsort is not stable, so equal keys
+are ordered by their original position.
+*/
+typedef struct {
+    const Eterm *pair;
+    usize index;
+} SortEntry;
+
+static int sort_entry_cmp(const void *a, const void *b) {
+    const SortEntry *x = a;
+    const SortEntry *y = b;
+    int c = term_cmp_exact(x->pair[0], y->pair[0]);
+    if (c != 0) return c;
+    return x->index < y->index ? -1 : (x->index > y->index ? 1 : 0);
+}
+
+void map_sort_pairs(Eterm *pairs, usize n, usize stride) {
+    if (n < 2) return;
+
+    // already sorted is the common case (literals, loader sorted lists)
+    usize i;
+    for (i = 1; i < n; i++) {
+        if (term_cmp_exact(pairs[(i - 1) * stride], pairs[i * stride]) > 0) break;
+    }
+    if (i == n) return;
+
+    SortEntry *entries = malloc(n * sizeof(SortEntry));
+    Eterm *sorted = malloc(n * stride * sizeof(Eterm));
+    if (!entries || !sorted) {
+        perror("malloc failed");
+        exit(1);
+    }
+    for (i = 0; i < n; i++) {
+        entries[i].pair = pairs + i * stride;
+        entries[i].index = i;
+    }
+    qsort(entries, n, sizeof(SortEntry), sort_entry_cmp);
+    for (i = 0; i < n; i++) {
+        memcpy(sorted + i * stride, entries[i].pair, stride * sizeof(Eterm));
+    }
+    memcpy(pairs, sorted, n * stride * sizeof(Eterm));
+    free(sorted);
+    free(entries);
+}
+
+/* -- HAMT -- */
+
+static int node_prefix(const Eterm *node) {
+    switch (header_subtag(node[0])) {
+    case SUBTAG_HASHMAP:   return ROOT_PREFIX;
+    case SUBTAG_HAMT_NODE: return NODE_PREFIX;
+    default:               return COLLISION_PREFIX;
+    }
+}
+
+static Uint32 node_bitmap(const Eterm *node) {
+    return (Uint32)small_value(node[node_prefix(node) - 1]);
+}
+
+// copy of node with child pos replaced, or a new child inserted before pos
+static Eterm *node_with_child(Heap *heap, const Eterm *node, usize pos, Eterm child, int insert) {
+    usize arity = header_arity(node[0]);
+    usize at = node_prefix(node) + pos;
+    Eterm *hp = heap_alloc(heap, 1 + arity + (insert ? 1 : 0));
+
+    memcpy(hp, node, at * sizeof(Eterm));
+    hp[at] = child;
+    if (insert) {
+        memcpy(hp + at + 1, node + at, (1 + arity - at) * sizeof(Eterm));
+        hp[0] = make_header(arity + 1, header_subtag(node[0]));
+    } else {
+        memcpy(hp + at + 1, node + at + 1, (arity - at) * sizeof(Eterm));
+    }
+    return hp;
+}
+
+// smallest node holding two leaves whose keys differ
+static Eterm hamt_pair(Heap *heap, int depth, Eterm leaf_a, Uint64 hash_a, Eterm leaf_b, Uint64 hash_b) {
+    if (depth >= HAMT_MAX_DEPTH) {
+        Eterm *hp = heap_alloc(heap, 3);
+        hp[0] = make_header(2, SUBTAG_HAMT_COLLISION);
+        int a_first = term_cmp_exact(CAR(list_val(leaf_a)), CAR(list_val(leaf_b))) < 0;
+        hp[1] = a_first ? leaf_a : leaf_b;
+        hp[2] = a_first ? leaf_b : leaf_a;
+        return make_boxed(hp);
+    }
+
+    Uint32 ia = hamt_index(hash_a, depth);
+    Uint32 ib = hamt_index(hash_b, depth);
+    if (ia == ib) {
+        Eterm child = hamt_pair(heap, depth + 1, leaf_a, hash_a, leaf_b, hash_b);
+        Eterm *hp = heap_alloc(heap, 3);
+        hp[0] = make_header(2, SUBTAG_HAMT_NODE);
+        hp[1] = make_small(1u << ia);
+        hp[2] = child;
+        return make_boxed(hp);
+    }
+
+    Eterm *hp = heap_alloc(heap, 4);
+    hp[0] = make_header(3, SUBTAG_HAMT_NODE);
+    hp[1] = make_small((1u << ia) | (1u << ib));
+    hp[2] = ia < ib ? leaf_a : leaf_b;
+    hp[3] = ia < ib ? leaf_b : leaf_a;
+    return make_boxed(hp);
+}
+
+static Eterm collision_put(Heap *heap, Eterm *node, Eterm key, Eterm value, int exact, int *added) {
+    usize n = header_arity(node[0]);
+    usize pos = 0;
+
+    for (usize i = 0; i < n; i++) {
+        Eterm *leaf = list_val(node[COLLISION_PREFIX + i]);
+        if (map_key_eq(CAR(leaf), key)) {
+            if (CDR(leaf) == value) return make_boxed(node);
+            return make_boxed(node_with_child(heap, node, i, make_leaf(heap, key, value), 0));
+        }
+        if (term_cmp_exact(CAR(leaf), key) < 0) pos = i + 1;
+    }
+    if (exact) return THE_NON_VALUE;
+
+    *added = 1;
+    return make_boxed(node_with_child(heap, node, pos, make_leaf(heap, key, value), 1));
+}
+
+// puts key into the root or inner node at depth, returns the node itself when nothing changed
+static Eterm hamt_put(Heap *heap, Eterm *node, int depth, Uint64 hash, Eterm key, Eterm value,
+                      int exact, int *added) {
+    if (header_subtag(node[0]) == SUBTAG_HAMT_COLLISION) {
+        return collision_put(heap, node, key, value, exact, added);
+    }
+
+    int prefix = node_prefix(node);
+    Uint32 bitmap = node_bitmap(node);
+    Uint32 bit = 1u << hamt_index(hash, depth);
+    usize pos = __builtin_popcount(bitmap & (bit - 1));
+    Eterm *hp;
+
+    if (!(bitmap & bit)) {
+        if (exact) return THE_NON_VALUE;
+        *added = 1;
+        hp = node_with_child(heap, node, pos, make_leaf(heap, key, value), 1);
+        hp[prefix - 1] = make_small(bitmap | bit);
+    } else {
+        Eterm child = node[prefix + pos];
+        Eterm new_child;
+
+        if (is_list(child)) {
+            Eterm *leaf = list_val(child);
+            if (map_key_eq(CAR(leaf), key)) {
+                if (CDR(leaf) == value) return make_boxed(node);
+                new_child = make_leaf(heap, key, value);
+            } else {
+                if (exact) return THE_NON_VALUE;
+                *added = 1;
+                new_child = hamt_pair(heap, depth + 1, child, term_hash(CAR(leaf)),
+                                      make_leaf(heap, key, value), hash);
+            }
+        } else {
+            new_child = hamt_put(heap, boxed_val(child), depth + 1, hash, key, value, exact, added);
+            if (!is_value(new_child)) return THE_NON_VALUE;
+            if (new_child == child) return make_boxed(node);
+        }
+        hp = node_with_child(heap, node, pos, new_child, 0);
+    }
+
+    if (prefix == ROOT_PREFIX) hp[1] = make_small(small_value(node[1]) + *added);
+    return make_boxed(hp);
+}
+
+static Eterm hashmap_put(Heap *heap, Eterm map, Eterm key, Eterm value, int exact) {
+    int added = 0;
+    return hamt_put(heap, boxed_val(map), 0, term_hash(key), key, value, exact, &added);
+}
+
+static Eterm hashmap_get(Eterm map, Eterm key) {
+    Uint64 hash = term_hash(key);
+    Eterm *node = boxed_val(map);
+
+    for (int depth = 0;; depth++) {
+        if (header_subtag(node[0]) == SUBTAG_HAMT_COLLISION) {
+            usize n = header_arity(node[0]);
+            for (usize i = 1; i <= n; i++) {
+                Eterm *leaf = list_val(node[i]);
+                if (map_key_eq(CAR(leaf), key)) return CDR(leaf);
+            }
+            return THE_NON_VALUE;
+        }
+
+        Uint32 bitmap = node_bitmap(node);
+        Uint32 bit = 1u << hamt_index(hash, depth);
+        if (!(bitmap & bit)) return THE_NON_VALUE;
+
+        Eterm child = node[node_prefix(node) + __builtin_popcount(bitmap & (bit - 1))];
+        if (is_list(child)) {
+            Eterm *leaf = list_val(child);
+            return map_key_eq(CAR(leaf), key) ? CDR(leaf) : THE_NON_VALUE;
+        }
+        node = boxed_val(child);
+    }
+}
+
+/*
+Builds a trie from entries with distinct keys in one pass, bucketing them
+by their hash bits level by level. Gives the same shape as inserting them
+one by one, without the garbage of the intermediate maps.
+*/
+typedef struct {
+    Uint64 hash;
+    Eterm leaf;
+} HashEntry;
+
+static int hash_entry_key_cmp(const void *a, const void *b) {
+    return term_cmp_exact(CAR(list_val(((const HashEntry *)a)->leaf)),
+                          CAR(list_val(((const HashEntry *)b)->leaf)));
+}
+
+static Eterm hamt_build(Heap *heap, HashEntry *entries, HashEntry *tmp, usize n, int depth) {
+    if (depth >= HAMT_MAX_DEPTH) {
+        qsort(entries, n, sizeof(HashEntry), hash_entry_key_cmp);
+        Eterm *hp = heap_alloc(heap, COLLISION_PREFIX + n);
+        hp[0] = make_header(n, SUBTAG_HAMT_COLLISION);
+        for (usize i = 0; i < n; i++) hp[COLLISION_PREFIX + i] = entries[i].leaf;
+        return make_boxed(hp);
+    }
+
+    usize start[1 << HAMT_BITS] = {0};
+    usize count[1 << HAMT_BITS] = {0};
+    for (usize i = 0; i < n; i++) count[hamt_index(entries[i].hash, depth)]++;
+
+    Uint32 bitmap = 0;
+    usize children = 0, at = 0;
+    for (int b = 0; b < (1 << HAMT_BITS); b++) {
+        start[b] = at;
+        at += count[b];
+        if (count[b]) {
+            bitmap |= 1u << b;
+            children++;
+        }
+    }
+    // counting sort into tmp, then back
+    usize fill[1 << HAMT_BITS];
+    memcpy(fill, start, sizeof(fill));
+    for (usize i = 0; i < n; i++) tmp[fill[hamt_index(entries[i].hash, depth)]++] = entries[i];
+    memcpy(entries, tmp, n * sizeof(HashEntry));
+
+    int prefix = depth == 0 ? ROOT_PREFIX : NODE_PREFIX;
+    Eterm *hp = heap_alloc(heap, prefix + children);
+    hp[0] = make_header(prefix - 1 + children, depth == 0 ? SUBTAG_HASHMAP : SUBTAG_HAMT_NODE);
+    if (depth == 0) hp[1] = make_small(n);
+    hp[prefix - 1] = make_small(bitmap);
+
+    usize c = prefix;
+    for (int b = 0; b < (1 << HAMT_BITS); b++) {
+        if (count[b] == 1) {
+            hp[c++] = entries[start[b]].leaf;
+        } else if (count[b] > 1) {
+            hp[c++] = hamt_build(heap, entries + start[b], tmp + start[b], count[b], depth + 1);
+        }
+    }
+    return make_boxed(hp);
+}
+
+// appends every leaf below node to kvs (unsorted)
+static Eterm *hashmap_collect(const Eterm *node, Eterm *kvs) {
+    usize n = header_arity(node[0]);
+    for (usize i = node_prefix(node); i <= n; i++) {
+        if (is_list(node[i])) {
+            *kvs++ = CAR(list_val(node[i]));
+            *kvs++ = CDR(list_val(node[i]));
+        } else {
+            kvs = hashmap_collect(boxed_val(node[i]), kvs);
+        }
+    }
+    return kvs;
+}
+
+/* -- flatmaps -- */
+
+static usize flatmap_find(Eterm map, Eterm key) {
+    usize n = flatmap_size(map);
+    const Eterm *keys = tuple_val(flatmap_keys(map)) + 1;
+
+    if (is_immed(key)) {
+        for (usize i = 0; i < n; i++) {
+            if (keys[i] == key) return i;
+        }
+    } else {
+        for (usize i = 0; i < n; i++) {
+            if (map_key_eq(keys[i], key)) return i;
+        }
+    }
+    return n;
+}
+
+static Eterm flatmap_put(Heap *heap, Eterm map, Eterm key, Eterm value, int exact) {
+    usize n = flatmap_size(map);
+    const Eterm *keys = tuple_val(flatmap_keys(map)) + 1;
+    const Eterm *values = flatmap_values(map);
+
+    usize i = flatmap_find(map, key);
+    if (i < n) {
+        if (values[i] == value) return map;
+        Eterm res = make_flatmap(heap, flatmap_keys(map), values, n);
+        flatmap_values(res)[i] = value;
+        return res;
+    }
+    if (exact) return THE_NON_VALUE;
+
+    if (n == MAP_SMALL_LIMIT) {
+        Eterm kvs[2 * MAP_SMALL_LIMIT + 2];
+        for (i = 0; i < n; i++) {
+            kvs[2 * i] = keys[i];
+            kvs[2 * i + 1] = values[i];
+        }
+        kvs[2 * n] = key;
+        kvs[2 * n + 1] = value;
+        return map_from_pairs(heap, kvs, n + 1);
+    }
+
+    // binary search for the insert position
+    usize lo = 0, hi = n;
+    while (lo < hi) {
+        usize mid = (lo + hi) / 2;
+        if (term_cmp_exact(keys[mid], key) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+
+    // new key tuple (1 + n + 1 words) followed by the map (2 + n + 1 words)
+    Eterm *hp = heap_alloc(heap, 2 * n + 5);
+    Eterm new_keys = make_tuple(&hp, n + 1);
+    Eterm *nk = tuple_val(new_keys) + 1;
+    memcpy(nk, keys, lo * sizeof(Eterm));
+    nk[lo] = key;
+    memcpy(nk + lo + 1, keys + lo, (n - lo) * sizeof(Eterm));
+
+    hp[0] = make_header(2 + n, SUBTAG_FLATMAP);
+    hp[1] = new_keys;
+    memcpy(hp + 2, values, lo * sizeof(Eterm));
+    hp[2 + lo] = value;
+    memcpy(hp + 3 + lo, values + lo, (n - lo) * sizeof(Eterm));
+    return make_boxed(hp);
+}
+
+/* -- public -- */
+
+Eterm map_get(Eterm map, Eterm key) {
+    if (is_flatmap(map)) {
+        usize i = flatmap_find(map, key);
+        return i < flatmap_size(map) ? flatmap_values(map)[i] : THE_NON_VALUE;
+    }
+    return hashmap_get(map, key);
+}
+
+Eterm map_put(Heap *heap, Eterm map, Eterm key, Eterm value) {
+    if (is_flatmap(map)) return flatmap_put(heap, map, key, value, 0);
+    return hashmap_put(heap, map, key, value, 0);
+}
+
+Eterm map_update(Heap *heap, Eterm map, Eterm key, Eterm value) {
+    if (is_flatmap(map)) return flatmap_put(heap, map, key, value, 1);
+    return hashmap_put(heap, map, key, value, 1);
+}
+
+Eterm map_from_pairs(Heap *heap, const Eterm *kvs, usize n) {
+    if (n == 0) return map_new(heap);
+
+    Eterm *pairs = malloc(2 * n * sizeof(Eterm));
+    if (!pairs) {
+        perror("malloc failed");
+        exit(1);
+    }
+    memcpy(pairs, kvs, 2 * n * sizeof(Eterm));
+    map_sort_pairs(pairs, n, 2);
+
+    // equal keys are adjacent and in their original order, keep the last one
+    usize unique = 0;
+    for (usize i = 0; i < n; i++) {
+        if (unique > 0 && map_key_eq(pairs[2 * (unique - 1)], pairs[2 * i])) unique--;
+        pairs[2 * unique] = pairs[2 * i];
+        pairs[2 * unique + 1] = pairs[2 * i + 1];
+        unique++;
+    }
+
+    Eterm res;
+    if (unique <= MAP_SMALL_LIMIT) {
+        Eterm *hp = heap_alloc(heap, 1 + unique + 2 + unique);
+        Eterm keys = make_tuple(&hp, unique);
+        hp[0] = make_header(1 + unique, SUBTAG_FLATMAP);
+        hp[1] = keys;
+        for (usize i = 0; i < unique; i++) {
+            tuple_element(keys, i + 1) = pairs[2 * i];
+            hp[2 + i] = pairs[2 * i + 1];
+        }
+        res = make_boxed(hp);
+    } else {
+        HashEntry *entries = malloc(2 * unique * sizeof(HashEntry));
+        if (!entries) {
+            perror("malloc failed");
+            exit(1);
+        }
+        for (usize i = 0; i < unique; i++) {
+            entries[i].hash = term_hash(pairs[2 * i]);
+            entries[i].leaf = make_leaf(heap, pairs[2 * i], pairs[2 * i + 1]);
+        }
+        res = hamt_build(heap, entries, entries + unique, unique, 0);
+        free(entries);
+    }
+    free(pairs);
+    return res;
+}
+
+int map_get_elements(Eterm map, const Eterm *keys, usize n, Eterm *vals) {
+    if (is_flatmap(map)) {
+        usize m = flatmap_size(map);
+        const Eterm *mk = tuple_val(flatmap_keys(map)) + 1;
+        const Eterm *mv = flatmap_values(map);
+
+        // sorted keys appear in the map in the same order
+        usize i, j = 0;
+        for (i = 0; i < n; i++) {
+            while (j < m && !map_key_eq(mk[j], keys[i])) j++;
+            if (j == m) break;
+            vals[i] = mv[j++];
+        }
+        if (i == n) return 1;
+    }
+
+    // a missing key, or keys not in map order
+    for (usize i = 0; i < n; i++) {
+        vals[i] = map_get(map, keys[i]);
+        if (!is_value(vals[i])) return 0;
+    }
+    return 1;
+}
+
+Eterm map_put_pairs(Heap *heap, Eterm map, const Eterm *kvs, usize n, int exact) {
+    if (is_flatmap(map)) {
+        usize m = flatmap_size(map);
+        const Eterm *mk = tuple_val(flatmap_keys(map)) + 1;
+
+        // every key already present (struct updates): only the values are copied
+        usize i, j = 0;
+        for (i = 0; i < n; i++) {
+            while (j < m && !map_key_eq(mk[j], kvs[2 * i])) j++;
+            if (j == m) break;
+            j++;
+        }
+        if (i == n) {
+            Eterm res = make_flatmap(heap, flatmap_keys(map), flatmap_values(map), m);
+            Eterm *values = flatmap_values(res);
+            for (i = 0, j = 0; i < n; i++, j++) {
+                while (!map_key_eq(mk[j], kvs[2 * i])) j++;
+                values[j] = kvs[2 * i + 1];
+            }
+            return res;
+        }
+
+        // new keys that still fit a flatmap: merge everything at once
+        if (!exact && m + n <= MAP_SMALL_LIMIT) {
+            Eterm merged[4 * MAP_SMALL_LIMIT];
+            const Eterm *mv = flatmap_values(map);
+            for (j = 0; j < m; j++) {
+                merged[2 * j] = mk[j];
+                merged[2 * j + 1] = mv[j];
+            }
+            memcpy(merged + 2 * m, kvs, 2 * n * sizeof(Eterm));
+            return map_from_pairs(heap, merged, m + n);
+        }
+    }
+
+    for (usize i = 0; i < n; i++) {
+        map = exact ? map_update(heap, map, kvs[2 * i], kvs[2 * i + 1])
+                    : map_put(heap, map, kvs[2 * i], kvs[2 * i + 1]);
+        if (!is_value(map)) return THE_NON_VALUE;
+    }
+    return map;
+}
+
+void map_to_pairs(Eterm map, Eterm *kvs) {
+    if (is_flatmap(map)) {
+        usize n = flatmap_size(map);
+        for (usize i = 0; i < n; i++) {
+            kvs[2 * i] = tuple_element(flatmap_keys(map), i + 1);
+            kvs[2 * i + 1] = flatmap_values(map)[i];
+        }
+        return;
+    }
+    hashmap_collect(boxed_val(map), kvs);
+    map_sort_pairs(kvs, hashmap_size(map), 2);
+}
+
+static Eterm *pairs_of(Eterm map) {
+    Eterm *kvs = malloc((2 * map_size(map) + 1) * sizeof(Eterm));
+    if (!kvs) {
+        perror("malloc failed");
+        exit(1);
+    }
+    map_to_pairs(map, kvs);
+    return kvs;
+}
+
+int map_cmp(Eterm a, Eterm b, int exact) {
+    usize na = map_size(a);
+    usize nb = map_size(b);
+    if (na != nb) return na < nb ? -1 : 1;
+
+    Eterm *ka = pairs_of(a);
+    Eterm *kb = pairs_of(b);
+    int c = 0;
+    for (usize i = 0; i < na && c == 0; i++) {
+        c = term_cmp_exact(ka[2 * i], kb[2 * i]);
+    }
+    for (usize i = 0; i < na && c == 0; i++) {
+        c = exact ? term_cmp_exact(ka[2 * i + 1], kb[2 * i + 1]) : term_cmp(ka[2 * i + 1], kb[2 * i + 1]);
+    }
+    free(ka);
+    free(kb);
+    return c;
+}
+
+void print_map(FILE *out, Eterm map) {
+    Eterm *kvs = pairs_of(map);
+    usize n = map_size(map);
+
+    fprintf(out, "#{");
+    for (usize i = 0; i < n; i++) {
+        if (i) fprintf(out, ",");
+        print_term(out, kvs[2 * i]);
+        fprintf(out, " => ");
+        print_term(out, kvs[2 * i + 1]);
+    }
+    fprintf(out, "}");
+    free(kvs);
+}
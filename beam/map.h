@@ -0,0 +1,88 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "binary_parsing_helpers.h"
+#include "term.h"
+#include "heap.h"
+
+/*
+Maps.
+
+Maps with up to MAP_SMALL_LIMIT keys are flatmaps:
+    header (arity 1 + n) | keys | value 1 | ... | value n
+keys is a tuple of the n keys sorted by term_cmp_exact. Updating values
+never touches the keys, so every map derived from the same literal (all
+instances of a struct) shares one key tuple, and lookups of atom keys are
+a scan comparing words.
+
+Larger maps are hash array mapped tries keyed by term_hash, 5 bits per
+level. Updates copy the path from the root to the changed leaf and share
+everything else with the old map.
+    root       header (arity 2 + n) | size | bitmap | child 1 | ... | child n
+    node       header (arity 1 + n) | bitmap | child 1 | ... | child n
+    collision  header (arity n) | leaf 1 | ... | leaf n
+A child is either a leaf, a cons cell [Key | Value], or a node. Keys whose
+hashes agree in all HAMT_MAX_DEPTH levels end up in a collision node,
+sorted like flatmap keys. Size and bitmap are stored as small integers so
+every word after a map header is a term (see header_is_container).
+
+The shape of a map only depends on its keys, so equal maps are equal word
+for word and term_eq / term_hash need no special cases.
+
+Lookups return THE_NON_VALUE when the key is missing.
+*/
+#define MAP_SMALL_LIMIT  32
+#define HAMT_BITS        5
+#define HAMT_MAX_DEPTH   12     // 60 of the 64 hash bits
+
+#define is_flatmap(t)       is_boxed_subtag(t, SUBTAG_FLATMAP)
+#define is_hashmap(t)       is_boxed_subtag(t, SUBTAG_HASHMAP)
+#define is_map(t)           (is_flatmap(t) || is_hashmap(t))
+
+#define flatmap_size(t)     (header_arity(*boxed_val(t)) - 1)
+#define flatmap_keys(t)     (boxed_val(t)[1])
+#define flatmap_values(t)   (boxed_val(t) + 2)
+
+#define hashmap_size(t)     ((usize)small_value(boxed_val(t)[1]))
+
+static inline usize map_size(Eterm map) {
+    return is_flatmap(map) ? flatmap_size(map) : hashmap_size(map);
+}
+
+// keys are compared with =:=, immediates by their word
+static inline int map_key_eq(Eterm a, Eterm b) {
+    return a == b || (!is_immed(a) && !is_immed(b) && term_eq(a, b));
+}
+
+Eterm map_new(Heap *heap);
+// builds a map from n key/value pairs (kvs = k1, v1, k2, v2, ...), the last of equal keys wins
+Eterm map_from_pairs(Heap *heap, const Eterm *kvs, usize n);
+
+Eterm map_get(Eterm map, Eterm key);
+// map#{key => value}
+Eterm map_put(Heap *heap, Eterm map, Eterm key, Eterm value);
+// map#{key := value}, THE_NON_VALUE if key is missing
+Eterm map_update(Heap *heap, Eterm map, Eterm key, Eterm value);
+
+/*
+Instruction fast paths. The key lists come straight from the instruction
+operands; when the loader has sorted them (map_sort_pairs), a flatmap is
+matched in one forward walk over its keys. Unsorted lists are still handled
+correctly, just key by key.
+*/
+// get_map_elements: vals[i] = map[keys[i]], returns 0 if a key is missing
+int map_get_elements(Eterm map, const Eterm *keys, usize n, Eterm *vals);
+// put_map_assoc (exact = 0) and put_map_exact (exact = 1) of n pairs
+Eterm map_put_pairs(Heap *heap, Eterm map, const Eterm *kvs, usize n, int exact);
+
+// sorts n pairs of stride words by their first word (term_cmp_exact), stable
+void map_sort_pairs(Eterm *pairs, usize n, usize stride);
+
+// writes the 2 * map_size(map) keys and values to kvs, sorted by key
+void map_to_pairs(Eterm map, Eterm *kvs);
+
+// term order of two maps: size, then keys, then values (exact: see term_cmp_exact)
+int map_cmp(Eterm a, Eterm b, int exact);
+void print_map(FILE *out, Eterm map);
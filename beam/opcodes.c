@@ -0,0 +1,13 @@
+#include "opcodes.h"
+
+const OpInfo opcode_table[] = {
+    { NULL, 0 },
+#define OPCODE_INFO(num, name, arity) { #name, arity },
+    BEAM_OPCODES(OPCODE_INFO)
+#undef OPCODE_INFO
+};
+
+const OpInfo *opcode_info(int op) {
+    if (op < 1 || op > MAX_OPCODE) return NULL;
+    return &opcode_table[op];
+}
@@ -0,0 +1,215 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "binary_parsing_helpers.h"
+
+/*
+Generic BEAM instruction set (genop.tab in the OTP sources).
+X(opcode, name, arity)
+*/
+#define BEAM_OPCODES(X) \
+    X(  1, label,                 1) \
+    X(  2, func_info,             3) \
+    X(  3, int_code_end,          0) \
+    X(  4, call,                  2) \
+    X(  5, call_last,             3) \
+    X(  6, call_only,             2) \
+    X(  7, call_ext,              2) \
+    X(  8, call_ext_last,         3) \
+    X(  9, bif0,                  2) \
+    X( 10, bif1,                  4) \
+    X( 11, bif2,                  5) \
+    X( 12, allocate,              2) \
+    X( 13, allocate_heap,         3) \
+    X( 14, allocate_zero,         2) \
+    X( 15, allocate_heap_zero,    3) \
+    X( 16, test_heap,             2) \
+    X( 17, init,                  1) \
+    X( 18, deallocate,            1) \
+    X( 19, return,                0) \
+    X( 20, send,                  0) \
+    X( 21, remove_message,        0) \
+    X( 22, timeout,               0) \
+    X( 23, loop_rec,              2) \
+    X( 24, loop_rec_end,          1) \
+    X( 25, wait,                  1) \
+    X( 26, wait_timeout,          2) \
+    X( 27, m_plus,                4) \
+    X( 28, m_minus,               4) \
+    X( 29, m_times,               4) \
+    X( 30, m_div,                 4) \
+    X( 31, int_div,               4) \
+    X( 32, int_rem,               4) \
+    X( 33, int_band,              4) \
+    X( 34, int_bor,               4) \
+    X( 35, int_bxor,              4) \
+    X( 36, int_bsl,               4) \
+    X( 37, int_bsr,               4) \
+    X( 38, int_bnot,              3) \
+    X( 39, is_lt,                 3) \
+    X( 40, is_ge,                 3) \
+    X( 41, is_eq,                 3) \
+    X( 42, is_ne,                 3) \
+    X( 43, is_eq_exact,           3) \
+    X( 44, is_ne_exact,           3) \
+    X( 45, is_integer,            2) \
+    X( 46, is_float,              2) \
+    X( 47, is_number,             2) \
+    X( 48, is_atom,               2) \
+    X( 49, is_pid,                2) \
+    X( 50, is_reference,          2) \
+    X( 51, is_port,               2) \
+    X( 52, is_nil,                2) \
+    X( 53, is_binary,             2) \
+    X( 54, is_constant,           2) \
+    X( 55, is_list,               2) \
+    X( 56, is_nonempty_list,      2) \
+    X( 57, is_tuple,              2) \
+    X( 58, test_arity,            3) \
+    X( 59, select_val,            3) \
+    X( 60, select_tuple_arity,    3) \
+    X( 61, jump,                  1) \
+    X( 62, catch,                 2) \
+    X( 63, catch_end,             1) \
+    X( 64, move,                  2) \
+    X( 65, get_list,              3) \
+    X( 66, get_tuple_element,     3) \
+    X( 67, set_tuple_element,     3) \
+    X( 68, put_string,            3) \
+    X( 69, put_list,              3) \
+    X( 70, put_tuple,             2) \
+    X( 71, put,                   1) \
+    X( 72, badmatch,              1) \
+    X( 73, if_end,                0) \
+    X( 74, case_end,              1) \
+    X( 75, call_fun,              1) \
+    X( 76, make_fun,              3) \
+    X( 77, is_function,           2) \
+    X( 78, call_ext_only,         2) \
+    X( 79, bs_start_match,        2) \
+    X( 80, bs_get_integer,        5) \
+    X( 81, bs_get_float,          5) \
+    X( 82, bs_get_binary,         5) \
+    X( 83, bs_skip_bits,          4) \
+    X( 84, bs_test_tail,          2) \
+    X( 85, bs_save,               1) \
+    X( 86, bs_restore,            1) \
+    X( 87, bs_init,               2) \
+    X( 88, bs_final,              2) \
+    X( 89, bs_put_integer,        5) \
+    X( 90, bs_put_binary,         5) \
+    X( 91, bs_put_float,          5) \
+    X( 92, bs_put_string,         2) \
+    X( 93, bs_need_buf,           1) \
+    X( 94, fclearerror,           0) \
+    X( 95, fcheckerror,           1) \
+    X( 96, fmove,                 2) \
+    X( 97, fconv,                 2) \
+    X( 98, fadd,                  4) \
+    X( 99, fsub,                  4) \
+    X(100, fmul,                  4) \
+    X(101, fdiv,                  4) \
+    X(102, fnegate,               3) \
+    X(103, make_fun2,             1) \
+    X(104, try,                   2) \
+    X(105, try_end,               1) \
+    X(106, try_case,              1) \
+    X(107, try_case_end,          1) \
+    X(108, raise,                 2) \
+    X(109, bs_init2,              6) \
+    X(110, bs_bits_to_bytes,      3) \
+    X(111, bs_add,                5) \
+    X(112, apply,                 1) \
+    X(113, apply_last,            2) \
+    X(114, is_boolean,            2) \
+    X(115, is_function2,          3) \
+    X(116, bs_start_match2,       5) \
+    X(117, bs_get_integer2,       7) \
+    X(118, bs_get_float2,         7) \
+    X(119, bs_get_binary2,        7) \
+    X(120, bs_skip_bits2,         5) \
+    X(121, bs_test_tail2,         3) \
+    X(122, bs_save2,              2) \
+    X(123, bs_restore2,           2) \
+    X(124, gc_bif1,               5) \
+    X(125, gc_bif2,               6) \
+    X(126, bs_final2,             2) \
+    X(127, bs_bits_to_bytes2,     2) \
+    X(128, put_literal,           2) \
+    X(129, is_bitstr,             2) \
+    X(130, bs_context_to_binary,  1) \
+    X(131, bs_test_unit,          3) \
+    X(132, bs_match_string,       4) \
+    X(133, bs_init_writable,      0) \
+    X(134, bs_append,             8) \
+    X(135, bs_private_append,     6) \
+    X(136, trim,                  2) \
+    X(137, bs_init_bits,          6) \
+    X(138, bs_get_utf8,           5) \
+    X(139, bs_skip_utf8,          4) \
+    X(140, bs_get_utf16,          5) \
+    X(141, bs_skip_utf16,         4) \
+    X(142, bs_get_utf32,          5) \
+    X(143, bs_skip_utf32,         4) \
+    X(144, bs_utf8_size,          3) \
+    X(145, bs_put_utf8,           3) \
+    X(146, bs_utf16_size,         3) \
+    X(147, bs_put_utf16,          3) \
+    X(148, bs_put_utf32,          3) \
+    X(149, on_load,               0) \
+    X(150, recv_mark,             1) \
+    X(151, recv_set,              1) \
+    X(152, gc_bif3,               7) \
+    X(153, line,                  1) \
+    X(154, put_map_assoc,         5) \
+    X(155, put_map_exact,         5) \
+    X(156, is_map,                2) \
+    X(157, has_map_fields,        3) \
+    X(158, get_map_elements,      3) \
+    X(159, is_tagged_tuple,       4) \
+    X(160, build_stacktrace,      0) \
+    X(161, raw_raise,             0) \
+    X(162, get_hd,                2) \
+    X(163, get_tl,                2) \
+    X(164, put_tuple2,            2) \
+    X(165, bs_get_tail,           3) \
+    X(166, bs_start_match3,       4) \
+    X(167, bs_get_position,       3) \
+    X(168, bs_set_position,       2) \
+    X(169, swap,                  2) \
+    X(170, bs_start_match4,       4) \
+    X(171, make_fun3,             3) \
+    X(172, init_yregs,            1) \
+    X(173, recv_marker_bind,      2) \
+    X(174, recv_marker_clear,     1) \
+    X(175, recv_marker_reserve,   1) \
+    X(176, recv_marker_use,       1) \
+    X(177, bs_create_bin,         6) \
+    X(178, call_fun2,             3) \
+    X(179, nif_start,             0) \
+    X(180, badrecord,             1) \
+    X(181, update_record,         5) \
+    X(182, bs_match,              3) \
+    X(183, executable_line,       2) \
+    X(184, debug_line,            4)
+
+typedef enum {
+#define OPCODE_ENUM(num, name, arity) op_##name = num,
+    BEAM_OPCODES(OPCODE_ENUM)
+#undef OPCODE_ENUM
+    op_max_known
+} BeamOpcode;
+
+#define MAX_OPCODE (op_max_known - 1)
+
+typedef struct {
+    const char *name;
+    int arity;
+} OpInfo;
+
+// indexed by opcode, entry 0 is unused
+extern const OpInfo opcode_table[];
+
+// returns NULL for opcodes this runtime does not know
+const OpInfo *opcode_info(int op);
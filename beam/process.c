@@ -0,0 +1,243 @@
+#include "process.h"
+
+/*
+slots:      slot index -> PCB, written once when the PCB is created
+next_slot:  slots below it have a PCB (may run past slot_count when full)
+free_head:  global stack of free PCBs, (tag << 32) | first slot. The tag
+            changes with every update, so a pop that read a stale next
+            link cannot succeed (ABA).
+*/
+static _Atomic(Process *) *slots;
+static usize slot_count;
+static int index_bits;
+static _Atomic Uint64 next_slot;
+static _Atomic Uint64 free_head;
+
+// pids are immediates, 60 bits of payload: generation above the slot index
+#define PID_BITS 60
+
+#define HEAD_SLOT(h)        ((Uint32)(h))
+#define HEAD_TAG(h)         ((h) >> 32)
+#define MAKE_HEAD(tag, s)   (((Uint64)(tag) << 32) | (Uint32)(s))
+
+int process_table_init(usize max_processes) {
+    index_bits = 0;
+    while (((usize)1 << index_bits) < max_processes) index_bits++;
+    // PROCESS_NONE must stay out of range
+    if (index_bits > 31) {
+        fprintf(stderr, "Process table size %zu too large\n", max_processes);
+        return 0;
+    }
+
+    slot_count = (usize)1 << index_bits;
+    slots = calloc(slot_count, sizeof *slots);
+    if (!slots) {
+        perror("calloc failed");
+        exit(1);
+    }
+    atomic_init(&next_slot, 0);
+    atomic_init(&free_head, MAKE_HEAD(0, PROCESS_NONE));
+    return 1;
+}
+
+void process_table_destroy(void) {
+    usize used = atomic_load(&next_slot);
+    if (used > slot_count) used = slot_count;
+    for (usize i = 0; i < used; i++) {
+        Process *p = atomic_load(&slots[i]);
+        if (!p) continue;
+        heap_free(&p->heap);
+        free(p->stack);
+        free(p);
+    }
+    free(slots);
+    slots = NULL;
+    slot_count = 0;
+}
+
+usize process_table_size(void) {
+    return slot_count;
+}
+
+static Process *slot_process(Uint32 index) {
+    return atomic_load_explicit(&slots[index], memory_order_acquire);
+}
+
+static Eterm pid_of(const Process *p) {
+    Uint64 generation = p->generation & (((Uint64)1 << (PID_BITS - index_bits)) - 1);
+    return make_pid((generation << index_bits) | p->index);
+}
+
+// a PCB for a slot that never had one
+static Process *new_process(ProcessPool *pool) {
+    Uint64 index = atomic_fetch_add_explicit(&next_slot, 1, memory_order_relaxed);
+    if (index >= slot_count) return NULL;
+
+    // own cache lines, PCBs of different schedulers must not share one
+    Process *p = aligned_alloc(64, (sizeof(Process) + 63) / 64 * 64);
+    Eterm *stack = malloc(PROCESS_STACK_WORDS * sizeof(Eterm));
+    if (!p || !stack) {
+        perror("malloc failed");
+        exit(1);
+    }
+    atomic_init(&p->pid, NIL);
+    p->index = (Uint32)index;
+    p->generation = 0;
+    atomic_init(&p->refs, 0);
+    atomic_init(&p->next_free, PROCESS_NONE);
+    heap_init(&p->heap, PROCESS_HEAP_WORDS);
+    p->stack = stack;
+    p->stack_size = PROCESS_STACK_WORDS;
+    p->stop = stack + PROCESS_STACK_WORDS;
+
+    atomic_store_explicit(&slots[index], p, memory_order_release);
+    pool->allocated++;
+    return p;
+}
+
+/* ---------- global free stack ---------- */
+
+// pushes the chain first .. last, linked through next_free
+static void push_free(Uint32 first, Process *last) {
+    Uint64 head = atomic_load_explicit(&free_head, memory_order_relaxed);
+    do {
+        atomic_store_explicit(&last->next_free, HEAD_SLOT(head), memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&free_head, &head, MAKE_HEAD(HEAD_TAG(head) + 1, first),
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+static Process *pop_free(void) {
+    Uint64 head = atomic_load_explicit(&free_head, memory_order_acquire);
+    for (;;) {
+        Uint32 index = HEAD_SLOT(head);
+        if (index == PROCESS_NONE) return NULL;
+        // PCBs are never freed, reading a link that is stale by now is harmless
+        Process *p = slot_process(index);
+        Uint32 next = atomic_load_explicit(&p->next_free, memory_order_relaxed);
+        if (atomic_compare_exchange_weak_explicit(&free_head, &head, MAKE_HEAD(HEAD_TAG(head) + 1, next),
+                                                  memory_order_acquire, memory_order_acquire)) {
+            return p;
+        }
+    }
+}
+
+/* ---------- per scheduler pools ---------- */
+
+void process_pool_init(ProcessPool *pool, int id) {
+    pool->id = id;
+    pool->free = PROCESS_NONE;
+    pool->free_count = 0;
+    pool->spawned = 0;
+    pool->allocated = 0;
+}
+
+static void pool_push(ProcessPool *pool, Process *p) {
+    atomic_store_explicit(&p->next_free, pool->free, memory_order_relaxed);
+    pool->free = p->index;
+    pool->free_count++;
+}
+
+static Process *pool_pop(ProcessPool *pool) {
+    if (pool->free == PROCESS_NONE) return NULL;
+    Process *p = slot_process(pool->free);
+    pool->free = atomic_load_explicit(&p->next_free, memory_order_relaxed);
+    pool->free_count--;
+    return p;
+}
+
+// moves the first n free PCBs of the pool to the global stack
+static void spill(ProcessPool *pool, usize n) {
+    if (n == 0 || pool->free == PROCESS_NONE) return;
+    Uint32 first = pool->free;
+    Process *last = slot_process(first);
+    usize moved = 1;
+    while (moved < n) {
+        Uint32 next = atomic_load_explicit(&last->next_free, memory_order_relaxed);
+        if (next == PROCESS_NONE) break;
+        last = slot_process(next);
+        moved++;
+    }
+    pool->free = atomic_load_explicit(&last->next_free, memory_order_relaxed);
+    pool->free_count -= moved;
+    push_free(first, last);
+}
+
+void process_pool_destroy(ProcessPool *pool) {
+    spill(pool, pool->free_count);
+}
+
+/*
+Local free list first, then a batch from the global stack, then a new PCB.
+Spawn can fail while other schedulers still hold free PCBs in their pools,
+up to PROCESS_POOL_MAX each.
+*/
+Process *process_spawn(ProcessPool *pool) {
+    Process *p = pool_pop(pool);
+    if (!p && (p = pop_free()) != NULL) {
+        for (usize i = 1; i < PROCESS_POOL_MAX / 2; i++) {
+            Process *q = pop_free();
+            if (!q) break;
+            pool_push(pool, q);
+        }
+    }
+    if (!p) p = new_process(pool);
+    if (!p) return NULL;
+
+    p->stop = p->stack + p->stack_size;
+    p->reductions = 0;
+    p->scheduler = pool->id;
+    pool->spawned++;
+
+    // nobody can pin a free PCB, so there is no increment to lose
+    atomic_store_explicit(&p->refs, 1, memory_order_relaxed);
+
+    // publish last: a lookup that finds the pid sees an initialized process
+    atomic_store_explicit(&p->pid, pid_of(p), memory_order_release);
+    return p;
+}
+
+// the last reference is gone: make the PCB ready for the next process
+static void recycle(Process *p) {
+    p->generation++;
+    // keep one initial sized fragment, drop the rest of a grown heap
+    heap_shrink(&p->heap);
+}
+
+void process_exit(ProcessPool *pool, Process *p) {
+    atomic_store_explicit(&p->pid, NIL, memory_order_release);
+    if (atomic_fetch_sub_explicit(&p->refs, 1, memory_order_acq_rel) != 1) return;
+
+    recycle(p);
+    pool_push(pool, p);
+    if (pool->free_count > PROCESS_POOL_MAX) spill(pool, PROCESS_POOL_MAX / 2);
+}
+
+/*
+Pins first, then checks the pid again: the PCB may have been recycled
+between the first check and the pin, then the pin holds the next process
+of the slot (or nothing, refs 0) and is dropped.
+*/
+Process *process_lookup(Eterm pid) {
+    if (!is_pid(pid) || !slots) return NULL;
+    Process *p = slot_process((Uint32)(pid_val(pid) & (slot_count - 1)));
+    if (!p || atomic_load_explicit(&p->pid, memory_order_acquire) != pid) return NULL;
+
+    Uint32 refs = atomic_load_explicit(&p->refs, memory_order_relaxed);
+    do {
+        if (refs == 0) return NULL;
+    } while (!atomic_compare_exchange_weak_explicit(&p->refs, &refs, refs + 1, memory_order_acq_rel,
+                                                    memory_order_relaxed));
+
+    if (atomic_load_explicit(&p->pid, memory_order_acquire) != pid) {
+        process_release(p);
+        return NULL;
+    }
+    return p;
+}
+
+void process_release(Process *p) {
+    if (atomic_fetch_sub_explicit(&p->refs, 1, memory_order_acq_rel) != 1) return;
+    // it exited while pinned; this thread does not own a pool
+    recycle(p);
+    push_free(p->index, p);
+}
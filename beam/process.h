@@ -0,0 +1,81 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "binary_parsing_helpers.h"
+#include "term.h"
+#include "heap.h"
+
+/*
+Processes and the global process table.
+
+Every process control block (PCB) owns one slot of the table for its whole
+life, a pid is (generation, slot index). When a process exits the slot's
+generation is bumped, so old pids of that slot stop resolving even after
+the PCB has been handed out again. PCBs are never freed while the table
+exists, only recycled, so a pointer read from the table can always be
+dereferenced.
+
+process_lookup pins the process it returns: the PCB is not recycled until
+the caller calls process_release, so a send cannot reach the next process
+of the slot. A process that exits while pinned is recycled by the last
+release, into the global free stack.
+
+Spawn and exit work on the free list of the calling scheduler (a
+ProcessPool, only touched by its own thread). Recycled PCBs keep their
+initial heap fragment and stack. A pool that grows too large hands half of
+its PCBs to a global lock-free stack, an empty one takes from there. No
+path takes a lock.
+*/
+#define PROCESS_TABLE_DEFAULT  (1 << 20)
+#define PROCESS_HEAP_WORDS     233      // initial heap, the one fragment a recycled PCB keeps
+#define PROCESS_STACK_WORDS    64       // initial stack
+#define PROCESS_POOL_MAX       256      // free PCBs a scheduler keeps before spilling half
+
+#define PROCESS_NONE UINT32_MAX
+
+typedef struct process {
+    _Atomic Eterm pid;              // NIL while the PCB is free
+    Uint32 index;                   // table slot, fixed for the life of the PCB
+    Uint64 generation;              // times the slot was used, part of the pid
+    _Atomic Uint32 refs;            // 1 while running plus pinned lookups, 0 while free
+    _Atomic Uint32 next_free;       // free list link (slot index), PROCESS_NONE at the end
+
+    Heap heap;
+    Eterm *stack;                   // grows down from stack + stack_size
+    Eterm *stop;
+    usize stack_size;
+
+    usize reductions;
+    int scheduler;                  // id of the scheduler that spawned it
+} Process;
+
+// free PCBs of one scheduler
+typedef struct {
+    int id;
+    Uint32 free;                    // first free slot, PROCESS_NONE if empty
+    usize free_count;
+    usize spawned;                  // statistics
+    usize allocated;                // PCBs created by this pool
+} ProcessPool;
+
+// max_processes is rounded up to a power of two; returns 0 if it is too large
+int process_table_init(usize max_processes);
+// frees every PCB; no process may be used any more
+void process_table_destroy(void);
+usize process_table_size(void);
+
+void process_pool_init(ProcessPool *pool, int id);
+// hands the free PCBs of the pool to the global free stack
+void process_pool_destroy(ProcessPool *pool);
+
+// returns a new process with an empty heap and stack, NULL if the table is full
+Process *process_spawn(ProcessPool *pool);
+// p must be running on the scheduler owning pool
+void process_exit(ProcessPool *pool, Process *p);
+// returns the live process for pid pinned, NULL if it exited (or pid is not a pid)
+Process *process_lookup(Eterm pid);
+// unpins a process returned by process_lookup, callable from any thread
+void process_release(Process *p);
@@ -0,0 +1,74 @@
+#include <time.h>
+#include "scheduler.h"
+
+Uint64 scheduler_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (Uint64)ts.tv_sec * 1000 + (Uint64)ts.tv_nsec / 1000000;
+}
+
+void scheduler_init(Scheduler *s, int id) {
+    s->id = id;
+    timer_wheel_init(&s->timers, scheduler_now());
+    process_pool_init(&s->procs, id);
+
+    // sleep deadlines are monotonic, so the condition must use the same clock
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&s->wakeup, &attr);
+    pthread_condattr_destroy(&attr);
+
+    pthread_mutex_init(&s->lock, NULL);
+    s->wake_pending = 0;
+}
+
+void scheduler_destroy(Scheduler *s) {
+    process_pool_destroy(&s->procs);
+    pthread_cond_destroy(&s->wakeup);
+    pthread_mutex_destroy(&s->lock);
+}
+
+void scheduler_set_timer(Scheduler *s, Timer *t, Uint64 timeout_ms) {
+    timer_wheel_insert(&s->timers, t, scheduler_now() + timeout_ms);
+}
+
+int scheduler_cancel_timer(Scheduler *s, Timer *t) {
+    return timer_wheel_cancel(&s->timers, t);
+}
+
+usize scheduler_bump_timers(Scheduler *s) {
+    // nothing armed: skip reading the clock
+    if (s->timers.count == 0) return 0;
+    return timer_wheel_advance(&s->timers, scheduler_now());
+}
+
+usize scheduler_sleep(Scheduler *s) {
+    Uint64 deadline;
+    int has_timer = timer_wheel_next_deadline(&s->timers, &deadline);
+
+    pthread_mutex_lock(&s->lock);
+    while (!s->wake_pending) {
+        if (!has_timer) {
+            pthread_cond_wait(&s->wakeup, &s->lock);
+            continue;
+        }
+        if (scheduler_now() >= deadline) break;
+
+        struct timespec ts;
+        ts.tv_sec = (time_t)(deadline / 1000);
+        ts.tv_nsec = (long)(deadline % 1000) * 1000000;
+        pthread_cond_timedwait(&s->wakeup, &s->lock, &ts);
+    }
+    s->wake_pending = 0;
+    pthread_mutex_unlock(&s->lock);
+
+    return scheduler_bump_timers(s);
+}
+
+void scheduler_wake(Scheduler *s) {
+    pthread_mutex_lock(&s->lock);
+    s->wake_pending = 1;
+    pthread_cond_signal(&s->wakeup);
+    pthread_mutex_unlock(&s->lock);
+}
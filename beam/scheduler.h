@@ -0,0 +1,46 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "binary_parsing_helpers.h"
+#include "term.h"
+#include "timer.h"
+#include "process.h"
+
+/*
+A scheduler is one OS thread running processes. It owns a timer wheel for the
+receive ... after timeouts and send_after timers of its processes, and a
+pool of free process control blocks for spawn and exit; only the scheduler
+thread itself touches the wheel and the pool.
+
+When there is nothing to run the scheduler sleeps until the next timer
+deadline or until another thread wakes it, whichever comes first.
+*/
+typedef struct scheduler {
+    int id;
+    TimerWheel timers;
+    ProcessPool procs;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    int wake_pending;
+} Scheduler;
+
+// monotonic time in timer ticks (milliseconds)
+Uint64 scheduler_now(void);
+
+void scheduler_init(Scheduler *s, int id);
+void scheduler_destroy(Scheduler *s);
+
+// arms t to fire timeout_ms from now (receive ... after, send_after)
+void scheduler_set_timer(Scheduler *s, Timer *t, Uint64 timeout_ms);
+int scheduler_cancel_timer(Scheduler *s, Timer *t);
+// runs the expired timers, called between process time slices
+usize scheduler_bump_timers(Scheduler *s);
+
+// blocks until the next timer deadline or scheduler_wake, then runs expired timers
+usize scheduler_sleep(Scheduler *s);
+// wakes a sleeping scheduler, callable from any thread
+void scheduler_wake(Scheduler *s);
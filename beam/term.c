@@ -0,0 +1,368 @@
+#include <math.h>
+#include "term.h"
+#include "atom.h"
+#include "big.h"
+#include "map.h"
+
+Eterm make_tuple(Eterm **hpp, usize arity) {
+    Eterm *hp = *hpp;
+    hp[0] = make_tuple_header(arity);
+    *hpp = hp + 1 + arity;
+    return make_boxed(hp);
+}
+
+Eterm make_cons(Eterm **hpp, Eterm head, Eterm tail) {
+    Eterm *hp = *hpp;
+    CAR(hp) = head;
+    CDR(hp) = tail;
+    *hpp = hp + 2;
+    return make_list(hp);
+}
+
+Eterm make_float(Eterm **hpp, double value) {
+    Eterm *hp = *hpp;
+    hp[0] = make_header(FLOAT_SIZE - 1, SUBTAG_FLOAT);
+    memcpy(&hp[1], &value, sizeof(double));
+    *hpp = hp + FLOAT_SIZE;
+    return make_boxed(hp);
+}
+
+double float_val(Eterm t) {
+    double d;
+    memcpy(&d, &boxed_val(t)[1], sizeof(double));
+    return d;
+}
+
+Eterm make_binary(Eterm **hpp, const byte *data, usize len) {
+    Eterm *hp = *hpp;
+    usize words = BINARY_WORDS(len);
+    hp[0] = make_header(words, SUBTAG_BINARY);
+    hp[1] = (Eterm)len;
+    // zero the padding so binaries can be compared and hashed word-wise
+    hp[words] = 0;
+    memcpy(&hp[2], data, len);
+    *hpp = hp + 1 + words;
+    return make_boxed(hp);
+}
+
+usize term_size(Eterm t) {
+    usize size = 0;
+
+    for (;;) {
+        if (is_list(t)) {
+            Eterm *cons = list_val(t);
+            size += 2 + term_size(CAR(cons));
+            t = CDR(cons);
+            continue;
+        }
+        if (!is_boxed(t)) return size;
+
+        Eterm *ptr = boxed_val(t);
+        usize arity = header_arity(*ptr);
+        size += 1 + arity;
+
+        if (header_is_container(*ptr)) {
+            for (usize i = 1; i <= arity; i++) {
+                size += term_size(ptr[i]);
+            }
+        }
+        return size;
+    }
+}
+
+Eterm copy_term(Eterm t, Eterm **hpp) {
+    if (is_immed(t)) return t;
+
+    if (is_list(t)) {
+        // copy the spine iteratively so long lists do not recurse
+        Eterm result;
+        Eterm *prev = NULL;
+        while (is_list(t)) {
+            Eterm *cons = list_val(t);
+            Eterm *hp = *hpp;
+            *hpp = hp + 2;
+            CAR(hp) = copy_term(CAR(cons), hpp);
+            if (prev) {
+                CDR(prev) = make_list(hp);
+            } else {
+                result = make_list(hp);
+            }
+            prev = hp;
+            t = CDR(cons);
+        }
+        CDR(prev) = copy_term(t, hpp);
+        return result;
+    }
+
+    Eterm *ptr = boxed_val(t);
+    usize arity = header_arity(*ptr);
+    Eterm *hp = *hpp;
+    *hpp = hp + 1 + arity;
+
+    if (header_is_container(*ptr)) {
+        hp[0] = ptr[0];
+        for (usize i = 1; i <= arity; i++) {
+            hp[i] = copy_term(ptr[i], hpp);
+        }
+    } else {
+        // floats, binaries and bignums hold no terms, copy them as raw words
+        memcpy(hp, ptr, (1 + arity) * sizeof(Eterm));
+    }
+    return make_boxed(hp);
+}
+
+int term_eq(Eterm a, Eterm b) {
+    for (;;) {
+        if (a == b) return 1;
+
+        if (is_list(a)) {
+            if (!is_list(b)) return 0;
+            Eterm *ca = list_val(a);
+            Eterm *cb = list_val(b);
+            if (!term_eq(CAR(ca), CAR(cb))) return 0;
+            a = CDR(ca);
+            b = CDR(cb);
+            continue;
+        }
+        if (!is_boxed(a) || !is_boxed(b)) return 0;
+
+        Eterm *pa = boxed_val(a);
+        Eterm *pb = boxed_val(b);
+        if (pa[0] != pb[0]) return 0;
+
+        usize arity = header_arity(pa[0]);
+        // maps have one shape per key set, so they compare like tuples
+        if (header_is_container(pa[0])) {
+            for (usize i = 1; i <= arity; i++) {
+                if (!term_eq(pa[i], pb[i])) return 0;
+            }
+            return 1;
+        }
+        // raw objects with equal headers: equal if their words are equal
+        return memcmp(pa + 1, pb + 1, arity * sizeof(Eterm)) == 0;
+    }
+}
+
+/*
+Standard term order:
+number < atom < reference < fun < port < pid < tuple < map < nil < list < bitstring
+*/
+enum {
+    ORDER_NUMBER,
+    ORDER_ATOM,
+    ORDER_PID,
+    ORDER_TUPLE,
+    ORDER_MAP,
+    ORDER_NIL,
+    ORDER_LIST,
+    ORDER_BINARY
+};
+
+static int order_class(Eterm t) {
+    if (is_small(t)) return ORDER_NUMBER;
+    if (is_atom(t)) return ORDER_ATOM;
+    if (is_pid(t)) return ORDER_PID;
+    if (is_nil(t)) return ORDER_NIL;
+    if (is_list(t)) return ORDER_LIST;
+
+    switch (header_subtag(*boxed_val(t))) {
+    case SUBTAG_TUPLE:   return ORDER_TUPLE;
+    case SUBTAG_FLATMAP:
+    case SUBTAG_HASHMAP: return ORDER_MAP;
+    case SUBTAG_BINARY:  return ORDER_BINARY;
+    default:             return ORDER_NUMBER;
+    }
+}
+
+#define CMP(a, b) ((a) < (b) ? -1 : ((a) > (b) ? 1 : 0))
+
+static int number_cmp(Eterm a, Eterm b, int exact) {
+    if (is_small(a) && is_small(b)) {
+        return CMP(small_value(a), small_value(b));
+    }
+    if (!is_float(a) && !is_float(b)) return big_cmp(a, b);
+
+    if (exact) {
+        if (!is_float(a)) return -1;
+        if (!is_float(b)) return 1;
+        double fa = float_val(a);
+        double fb = float_val(b);
+        if (fa != fb) return CMP(fa, fb);
+        // 0.0 and -0.0
+        return CMP(boxed_val(a)[1], boxed_val(b)[1]);
+    }
+
+    double fa = is_float(a) ? float_val(a) : (is_small(a) ? (double)small_value(a) : big_to_double(a));
+    double fb = is_float(b) ? float_val(b) : (is_small(b) ? (double)small_value(b) : big_to_double(b));
+    if (fa != fb) return CMP(fa, fb);
+
+    // equal as doubles, but a large small may have been rounded
+    if (is_small(a) && !is_small(b) && fabs(fb) < 9.2e18) return CMP(small_value(a), (Sint64)fb);
+    if (is_small(b) && !is_small(a) && fabs(fa) < 9.2e18) return CMP((Sint64)fa, small_value(b));
+    return 0;
+}
+
+static int compare(Eterm a, Eterm b, int exact) {
+    for (;;) {
+        if (a == b) return 0;
+
+        int ca = order_class(a);
+        int cb = order_class(b);
+        if (ca != cb) return CMP(ca, cb);
+
+        switch (ca) {
+        case ORDER_NUMBER:
+            return number_cmp(a, b, exact);
+        case ORDER_ATOM:
+            return atom_cmp(atom_val(a), atom_val(b));
+        case ORDER_PID:
+            return CMP(pid_val(a), pid_val(b));
+        case ORDER_TUPLE: {
+            usize na = tuple_arity(a);
+            usize nb = tuple_arity(b);
+            if (na != nb) return CMP(na, nb);
+            for (usize i = 1; i <= na; i++) {
+                int c = compare(tuple_element(a, i), tuple_element(b, i), exact);
+                if (c != 0) return c;
+            }
+            return 0;
+        }
+        case ORDER_MAP:
+            return map_cmp(a, b, exact);
+        case ORDER_LIST: {
+            Eterm *la = list_val(a);
+            Eterm *lb = list_val(b);
+            int c = compare(CAR(la), CAR(lb), exact);
+            if (c != 0) return c;
+            a = CDR(la);
+            b = CDR(lb);
+            continue;
+        }
+        case ORDER_BINARY: {
+            usize na = binary_size(a);
+            usize nb = binary_size(b);
+            int c = memcmp(binary_bytes(a), binary_bytes(b), na < nb ? na : nb);
+            if (c != 0) return c;
+            return CMP(na, nb);
+        }
+        default:
+            return 0;
+        }
+    }
+}
+
+int term_cmp(Eterm a, Eterm b) {
+    return compare(a, b, 0);
+}
+
+int term_cmp_exact(Eterm a, Eterm b) {
+    return compare(a, b, 1);
+}
+
+static Uint64 mix64(Uint64 h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+#define HASH_COMBINE(h, v) (mix64((h) ^ ((v) + 0x9e3779b97f4a7c15ULL + ((h) << 6) + ((h) >> 2))))
+
+Uint64 term_hash(Eterm t) {
+    Uint64 h = 0;
+
+    for (;;) {
+        if (is_immed(t)) return HASH_COMBINE(h, t);
+
+        if (is_list(t)) {
+            Eterm *cons = list_val(t);
+            h = HASH_COMBINE(h, term_hash(CAR(cons)));
+            t = CDR(cons);
+            continue;
+        }
+
+        Eterm *ptr = boxed_val(t);
+        usize arity = header_arity(*ptr);
+        h = HASH_COMBINE(h, ptr[0]);
+
+        if (header_is_container(*ptr)) {
+            for (usize i = 1; i <= arity; i++) {
+                h = HASH_COMBINE(h, term_hash(ptr[i]));
+            }
+        } else {
+            for (usize i = 1; i <= arity; i++) {
+                h = HASH_COMBINE(h, ptr[i]);
+            }
+        }
+        return h;
+    }
+}
+
+static void print_binary(FILE *out, Eterm t) {
+    usize len = binary_size(t);
+    const byte *data = binary_bytes(t);
+
+    int printable = 1;
+    for (usize i = 0; i < len; i++) {
+        if (data[i] < 0x20 || data[i] > 0x7e) {
+            printable = 0;
+            break;
+        }
+    }
+
+    if (printable) {
+        fprintf(out, "<<\"%.*s\">>", (int)len, (const char *)data);
+        return;
+    }
+
+    fprintf(out, "<<");
+    for (usize i = 0; i < len; i++) {
+        fprintf(out, i ? ",%u" : "%u", data[i]);
+    }
+    fprintf(out, ">>");
+}
+
+void print_term(FILE *out, Eterm t) {
+    if (is_small(t)) {
+        fprintf(out, "%" PRId64, small_value(t));
+    } else if (is_atom(t)) {
+        fprintf(out, "%s", atom_name(atom_val(t), NULL));
+    } else if (is_pid(t)) {
+        fprintf(out, "<0.%" PRIu64 ".0>", pid_val(t));
+    } else if (is_nil(t)) {
+        fprintf(out, "[]");
+    } else if (is_list(t)) {
+        fprintf(out, "[");
+        int first = 1;
+        while (is_list(t)) {
+            if (!first) fprintf(out, ",");
+            print_term(out, CAR(list_val(t)));
+            t = CDR(list_val(t));
+            first = 0;
+        }
+        if (!is_nil(t)) {
+            fprintf(out, "|");
+            print_term(out, t);
+        }
+        fprintf(out, "]");
+    } else if (is_tuple(t)) {
+        fprintf(out, "{");
+        for (usize i = 1; i <= tuple_arity(t); i++) {
+            if (i > 1) fprintf(out, ",");
+            print_term(out, tuple_element(t, i));
+        }
+        fprintf(out, "}");
+    } else if (is_float(t)) {
+        fprintf(out, "%g", float_val(t));
+    } else if (is_binary(t)) {
+        print_binary(out, t);
+    } else if (is_big(t)) {
+        big_print(out, t);
+    } else if (is_map(t)) {
+        print_map(out, t);
+    } else {
+        fprintf(out, "#Term<%#" PRIx64 ">", t);
+    }
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include "binary_parsing_helpers.h"
+
+/*
+Runtime term representation.
+
+Every term is one 64-bit word. The lowest 2 bits (primary tag) say what it is:
+00  header word (only found on the heap, first word of a boxed object)
+01  list        pointer to a cons cell [head, tail]
+10  boxed       pointer to a header word followed by the object data
+11  immediate   value stored directly in the word
+
+Immediates use the lowest 4 bits:
+0011  small integer (60 bit signed, value in the upper bits)
+0111  atom          (global atom id, see atom.h)
+1011  pid
+1111  special       (nil, the non value)
+
+Heap objects are 8 byte aligned, so the tag bits of a pointer are always free.
+*/
+typedef uint64_t Eterm;
+typedef uint16_t Uint16;
+typedef uint64_t Uint64;
+typedef int64_t  Sint64;
+
+#define TAG_PRIMARY_MASK    0x3
+#define TAG_PRIMARY_HEADER  0x0
+#define TAG_PRIMARY_LIST    0x1
+#define TAG_PRIMARY_BOXED   0x2
+#define TAG_PRIMARY_IMMED   0x3
+
+#define TAG_IMMED_MASK      0xF
+#define TAG_IMMED_SMALL     0x3
+#define TAG_IMMED_ATOM      0x7
+#define TAG_IMMED_PID       0xB
+#define TAG_IMMED_SPECIAL   0xF
+
+#define IMMED_SHIFT 4
+
+#define NIL           ((Eterm)((0 << IMMED_SHIFT) | TAG_IMMED_SPECIAL))
+#define THE_NON_VALUE ((Eterm)((1 << IMMED_SHIFT) | TAG_IMMED_SPECIAL))
+
+// small integers
+#define SMALL_BITS  60
+#define MAX_SMALL   ((Sint64)((((Uint64)1) << (SMALL_BITS - 1)) - 1))
+#define MIN_SMALL   (-MAX_SMALL - 1)
+#define IS_SSMALL(i) ((Sint64)(i) >= MIN_SMALL && (Sint64)(i) <= MAX_SMALL)
+
+#define make_small(i)   ((Eterm)((((Uint64)(i)) << IMMED_SHIFT) | TAG_IMMED_SMALL))
+#define small_value(t)  (((Sint64)(t)) >> IMMED_SHIFT)
+#define is_small(t)     (((t) & TAG_IMMED_MASK) == TAG_IMMED_SMALL)
+
+// atoms (global atom ids)
+#define make_atom(id)   ((Eterm)((((Uint64)(id)) << IMMED_SHIFT) | TAG_IMMED_ATOM))
+#define atom_val(t)     ((Uint32)((t) >> IMMED_SHIFT))
+#define is_atom(t)      (((t) & TAG_IMMED_MASK) == TAG_IMMED_ATOM)
+
+// pids
+#define make_pid(id)    ((Eterm)((((Uint64)(id)) << IMMED_SHIFT) | TAG_IMMED_PID))
+#define pid_val(t)      ((Uint64)((t) >> IMMED_SHIFT))
+#define is_pid(t)       (((t) & TAG_IMMED_MASK) == TAG_IMMED_PID)
+
+#define is_nil(t)       ((t) == NIL)
+#define is_value(t)     ((t) != THE_NON_VALUE)
+#define is_immed(t)     (((t) & TAG_PRIMARY_MASK) == TAG_PRIMARY_IMMED)
+
+// lists
+#define make_list(p)    ((Eterm)(uintptr_t)(p) | TAG_PRIMARY_LIST)
+#define list_val(t)     ((Eterm *)(uintptr_t)((t) - TAG_PRIMARY_LIST))
+#define is_list(t)      (((t) & TAG_PRIMARY_MASK) == TAG_PRIMARY_LIST)
+#define CAR(p)          ((p)[0])
+#define CDR(p)          ((p)[1])
+
+// boxed objects
+#define make_boxed(p)   ((Eterm)(uintptr_t)(p) | TAG_PRIMARY_BOXED)
+#define boxed_val(t)    ((Eterm *)(uintptr_t)((t) - TAG_PRIMARY_BOXED))
+#define is_boxed(t)     (((t) & TAG_PRIMARY_MASK) == TAG_PRIMARY_BOXED)
+
+/*
+Header word: arity (number of words following the header) in the upper bits,
+a 4 bit subtag saying what kind of object follows.
+*/
+#define HEADER_SUBTAG_SHIFT 2
+#define HEADER_ARITY_SHIFT  6
+
+#define SUBTAG_TUPLE    0x0
+#define SUBTAG_FLOAT    0x1
+#define SUBTAG_BINARY   0x2
+#define SUBTAG_POS_BIG  0x3
+#define SUBTAG_NEG_BIG  0x4
+// maps, see map.h
+#define SUBTAG_FLATMAP          0x5
+#define SUBTAG_HASHMAP          0x6
+#define SUBTAG_HAMT_NODE        0x7
+#define SUBTAG_HAMT_COLLISION   0x8
+
+#define make_header(arity, subtag) \
+    ((Eterm)((((Uint64)(arity)) << HEADER_ARITY_SHIFT) | ((subtag) << HEADER_SUBTAG_SHIFT) | TAG_PRIMARY_HEADER))
+#define header_arity(h)     ((usize)((h) >> HEADER_ARITY_SHIFT))
+#define header_subtag(h)    ((int)(((h) >> HEADER_SUBTAG_SHIFT) & 0xF))
+
+#define is_boxed_subtag(t, st) (is_boxed(t) && header_subtag(*boxed_val(t)) == (st))
+
+// objects whose words are all terms (tuples and map nodes), the rest are raw words
+#define header_is_container(h) (header_subtag(h) == SUBTAG_TUPLE || \
+                                (header_subtag(h) >= SUBTAG_FLATMAP && header_subtag(h) <= SUBTAG_HAMT_COLLISION))
+
+// tuples: header followed by the elements
+#define make_tuple_header(arity) make_header(arity, SUBTAG_TUPLE)
+#define is_tuple(t)         is_boxed_subtag(t, SUBTAG_TUPLE)
+#define tuple_val(t)        boxed_val(t)
+#define tuple_arity(t)      header_arity(*tuple_val(t))
+// 1-based like element/2
+#define tuple_element(t, i) (tuple_val(t)[(i)])
+
+// floats: header followed by one double
+#define FLOAT_SIZE          2
+#define is_float(t)         is_boxed_subtag(t, SUBTAG_FLOAT)
+
+// binaries: header, byte size, then the bytes padded to whole words
+#define BINARY_WORDS(n)     (1 + ((n) + sizeof(Eterm) - 1) / sizeof(Eterm))
+#define is_binary(t)        is_boxed_subtag(t, SUBTAG_BINARY)
+#define binary_size(t)      ((usize)boxed_val(t)[1])
+#define binary_bytes(t)     ((byte *)(boxed_val(t) + 2))
+
+// constructors writing into already reserved heap space, hp is advanced
+Eterm make_tuple(Eterm **hpp, usize arity);
+Eterm make_cons(Eterm **hpp, Eterm head, Eterm tail);
+Eterm make_float(Eterm **hpp, double value);
+Eterm make_binary(Eterm **hpp, const byte *data, usize len);
+double float_val(Eterm t);
+
+// number of heap words a deep copy of t needs
+usize term_size(Eterm t);
+// deep copies t into the space at *hpp (must hold term_size(t) words)
+Eterm copy_term(Eterm t, Eterm **hpp);
+
+// exact equality (=:=)
+int term_eq(Eterm a, Eterm b);
+// standard term order, returns <0, 0 or >0
+int term_cmp(Eterm a, Eterm b);
+// total order agreeing with term_eq: like term_cmp, but integers sort before floats
+int term_cmp_exact(Eterm a, Eterm b);
+// hash that agrees with term_eq
+Uint64 term_hash(Eterm t);
+
+void print_term(FILE *out, Eterm t);
@@ -0,0 +1,157 @@
+/*
+Integer arithmetic tests.
+
+Results of the arithmetic instructions are compared, printed in decimal,
+against values worked out independently: small results that overflow into
+bignums, bignum results that shrink back to smalls, truncating div and rem
+with every sign combination, two's complement band / bor / bxor / bnot on
+negative bignums, shifts rounding towards minus infinity, and operands
+long enough for Karatsuba multiplication. Bad arguments give badarith.
+
+usage: arith_test (exit status 0 if every case passes)
+*/
+#include "arith.h"
+#include "big.h"
+#include "atom.h"
+
+static int failed;
+static Heap heap;
+
+static void expect(int ok, const char *what) {
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failed++;
+    }
+}
+
+// t printed in decimal must be digits
+static void expect_value(Eterm t, const char *digits, const char *what) {
+    char *text = NULL;
+    size_t len = 0;
+    FILE *out = open_memstream(&text, &len);
+    if (is_small(t)) fprintf(out, "%" PRId64, small_value(t));
+    else if (is_big(t)) big_print(out, t);
+    else fprintf(out, "not an integer");
+    fclose(out);
+
+    if (strcmp(text, digits) != 0) {
+        printf("FAIL %s: %s, expected %s\n", what, text, digits);
+        failed++;
+    }
+    free(text);
+}
+
+// the integer written in decimal (Horner's rule on smalls)
+static Eterm integer(const char *digits) {
+    int negative = *digits == '-';
+    Eterm t = make_small(0);
+    for (const char *c = digits + negative; *c; c++) {
+        t = arith_plus(&heap, arith_times(&heap, t, make_small(10)), make_small(*c - '0'));
+    }
+    return negative ? arith_minus(&heap, make_small(0), t) : t;
+}
+
+static Eterm pow2(int n) {
+    return arith_bsl(&heap, make_small(1), make_small(n));
+}
+
+static void test_small_overflow(void) {
+    Eterm max = make_small(MAX_SMALL), min = make_small(MIN_SMALL);
+
+    Eterm t = arith_plus(&heap, max, make_small(1));
+    expect(is_big(t), "MAX_SMALL + 1 is a bignum");
+    expect_value(t, "576460752303423488", "MAX_SMALL + 1");
+    expect_value(arith_minus(&heap, min, make_small(1)), "-576460752303423489", "MIN_SMALL - 1");
+    expect_value(arith_times(&heap, max, max), "332306998946228967073030260463239169", "MAX_SMALL * MAX_SMALL");
+    expect_value(arith_int_div(&heap, min, make_small(-1)), "576460752303423488", "MIN_SMALL div -1");
+    expect_value(arith_bnot(&heap, min), "576460752303423487", "bnot MIN_SMALL");
+    expect_value(arith_bsl(&heap, make_small(1), make_small(59)), "576460752303423488", "1 bsl 59");
+    expect_value(arith_bsl(&heap, make_small(-1), make_small(64)), "-18446744073709551616", "-1 bsl 64");
+
+    // back in the small range: one representation per integer
+    t = arith_minus(&heap, arith_plus(&heap, max, make_small(10)), make_small(10));
+    expect(t == max, "bignum result that fits is a small");
+    t = arith_minus(&heap, pow2(64), arith_minus(&heap, pow2(64), make_small(5)));
+    expect(t == make_small(5), "difference of bignums is a small");
+    expect(arith_bsr(&heap, pow2(100), make_small(98)) == make_small(4), "bignum shifted into a small");
+}
+
+static void test_bignums(void) {
+    Eterm a = arith_plus(&heap, pow2(128), make_small(12345));
+    Eterm b = arith_minus(&heap, make_small(0), arith_plus(&heap, pow2(70), make_small(3)));
+
+    expect_value(a, "340282366920938463463374607431768223801", "2^128 + 12345");
+    expect_value(arith_times(&heap, a, b), "-401734511064747568886511370186053480595344430024436054266027", "a * b");
+    expect_value(arith_int_div(&heap, a, b), "-288230376151711743", "a div b");
+    expect_value(arith_int_rem(&heap, a, b), "1179726929588956180540", "a rem b");
+    Eterm neg_a = arith_minus(&heap, make_small(0), a);
+    expect_value(arith_int_div(&heap, neg_a, make_small(7)), "-48611766702991209066196372490252603400", "-a div 7");
+    expect_value(arith_int_rem(&heap, neg_a, make_small(7)), "-1", "-a rem 7");
+
+    expect_value(arith_band(&heap, b, arith_minus(&heap, pow2(80), make_small(1))), "1207745227993911763402749",
+                 "b band (2^80 - 1)");
+    expect_value(arith_bor(&heap, b, pow2(65)), "-1180591620717411303427", "b bor 2^65");
+    expect_value(arith_bxor(&heap, b, a), "-340282366920938464643966228149179527228", "b bxor a");
+    expect_value(arith_bnot(&heap, a), "-340282366920938463463374607431768223802", "bnot a");
+
+    Eterm c = arith_minus(&heap, make_small(0), arith_plus(&heap, pow2(100), make_small(1)));
+    expect_value(arith_bsr(&heap, c, make_small(99)), "-3", "bsr rounds towards minus infinity");
+    expect_value(arith_bsl(&heap, c, make_small(-99)), "-3", "negative bsl is bsr");
+    expect_value(arith_bsr(&heap, arith_minus(&heap, make_small(0), c), make_small(40)), "1152921504606846976",
+                 "(2^100 + 1) bsr 40");
+
+    Eterm f = make_small(1);
+    for (int i = 2; i <= 30; i++) f = arith_times(&heap, f, make_small(i));
+    expect_value(f, "265252859812191058636308480000000", "30!");
+    expect(big_cmp(f, integer("265252859812191058636308480000000")) == 0, "30! compares equal to its digits");
+    heap_reset(&heap);
+}
+
+// (2^n - 1)^2 == 2^2n - 2^(n+1) + 1, with n large enough for Karatsuba
+static void test_karatsuba(void) {
+    int n = 64 * (KARATSUBA_THRESHOLD + 8) + 5;
+    Eterm m = arith_minus(&heap, pow2(n), make_small(1));
+    Eterm square = arith_times(&heap, m, m);
+    Eterm expected = arith_plus(&heap, arith_minus(&heap, pow2(2 * n), pow2(n + 1)), make_small(1));
+    expect(big_cmp(square, expected) == 0, "Karatsuba square");
+
+    // q * b + r == a and |r| < |b| for long operands of both signs
+    Eterm b = arith_plus(&heap, pow2(n / 2), make_small(977));
+    for (int sa = 0; sa < 2; sa++) {
+        for (int sb = 0; sb < 2; sb++) {
+            Eterm x = sa ? arith_minus(&heap, make_small(0), square) : square;
+            Eterm y = sb ? arith_minus(&heap, make_small(0), b) : b;
+            Eterm q = arith_int_div(&heap, x, y);
+            Eterm r = arith_int_rem(&heap, x, y);
+            Eterm back = arith_plus(&heap, arith_times(&heap, q, y), r);
+            expect(big_cmp(back, x) == 0, "q * b + r == a");
+            expect(r == make_small(0) || big_cmp(r, make_small(0)) == (sa ? -1 : 1), "rem takes the sign of a");
+        }
+    }
+    heap_reset(&heap);
+}
+
+static void test_badarith(void) {
+    Eterm big = pow2(80);
+    expect(!is_value(arith_plus(&heap, make_small(1), am("one"))), "integer plus an atom");
+    expect(!is_value(arith_int_div(&heap, big, make_small(0))), "bignum div 0");
+    expect(!is_value(arith_int_rem(&heap, make_small(1), make_small(0))), "rem 0");
+    expect(!is_value(arith_bsl(&heap, make_small(1), big)), "shift by a bignum");
+    expect(!is_value(arith_bsl(&heap, make_small(1), make_small((Sint64)64 * BIG_MAX_DIGITS + 1))),
+           "shift past BIG_MAX_DIGITS");
+    expect(arith_bsr(&heap, make_small(-5), make_small(1000)) == make_small(-1), "long bsr of a negative small");
+    heap_reset(&heap);
+}
+
+int main(void) {
+    heap_init(&heap, 4096);
+
+    test_small_overflow();
+    test_bignums();
+    test_karatsuba();
+    test_badarith();
+
+    heap_free(&heap);
+    printf("%s: %d failed\n", failed ? "FAIL" : "ok", failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,262 @@
+/*
+ETS tests.
+
+set, bag and ordered_set semantics of insert, lookup, delete, traversal
+and update_counter (which turns counters into bignums past the small range
+and back), and that growing a hash table keeps bag objects with equal keys in
+insertion order (the table starts with 256 buckets and doubles past two
+objects per bucket, so the first resize is at 513 objects).
+
+Concurrency: threads insert, bump shared counters and delete on one table
+per configuration; afterwards every counter must hold every increment and
+the table exactly the keys that were not deleted.
+
+usage: ets_test (exit status 0 if every case passes)
+*/
+#include <pthread.h>
+#include "ets.h"
+#include "atom.h"
+#include "big.h"
+
+static int failed;
+static Heap heap;
+
+static void expect(int ok, const char *what) {
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failed++;
+    }
+}
+
+// {Key, Value}
+static Eterm pair(Sint64 key, Sint64 value) {
+    Eterm *hp = heap_alloc(&heap, 3);
+    Eterm tuple = make_tuple(&hp, 2);
+    tuple_element(tuple, 1) = make_small(key);
+    tuple_element(tuple, 2) = make_small(value);
+    return tuple;
+}
+
+// values of the objects lookup returns for key, in list order; returns the count
+static usize lookup_values(EtsTable *t, Sint64 key, Sint64 *values, usize max) {
+    Eterm list;
+    usize n = 0;
+    if (!ets_lookup(t, make_small(key), &heap, &list)) return 0;
+    for (; is_list(list); list = CDR(list_val(list))) {
+        Eterm tuple = CAR(list_val(list));
+        if (n < max) values[n] = small_value(tuple_element(tuple, 2));
+        n++;
+    }
+    return n;
+}
+
+static void test_set(EtsType type) {
+    EtsTable *t = ets_new(am("set"), type, 1, 0);
+    Sint64 v[4];
+
+    expect(ets_insert(t, pair(1, 10)) && ets_insert(t, pair(2, 20)), "insert");
+    expect(ets_insert(t, pair(1, 11)), "insert over an existing key");
+    expect(ets_size(t) == 2, "size counts keys");
+    expect(lookup_values(t, 1, v, 4) == 1 && v[0] == 11, "the later object replaces the earlier one");
+    expect(lookup_values(t, 3, v, 4) == 0, "lookup of a missing key");
+    expect(ets_member(t, make_small(2)) && !ets_member(t, make_small(3)), "member");
+    expect(!ets_insert(t, make_small(5)), "insert of a non tuple is badarg");
+
+    expect(ets_delete(t, make_small(1)) && !ets_member(t, make_small(1)), "delete");
+    expect(ets_delete(t, make_small(1)), "delete of a missing key");
+    expect(ets_size(t) == 1, "size after delete");
+    ets_delete_table(t);
+}
+
+static void test_bag(void) {
+    EtsTable *t = ets_new(am("bag"), ETS_BAG, 1, 0);
+    Sint64 v[4];
+
+    ets_insert(t, pair(1, 1));
+    ets_insert(t, pair(2, 1));
+    ets_insert(t, pair(1, 2));
+    ets_insert(t, pair(1, 1));
+    expect(ets_size(t) == 3, "duplicate objects are dropped");
+    expect(lookup_values(t, 1, v, 4) == 2 && v[0] == 1 && v[1] == 2, "objects come back in insertion order");
+    ets_delete(t, make_small(1));
+    expect(lookup_values(t, 1, v, 4) == 0 && ets_size(t) == 1, "delete removes every object with the key");
+    ets_delete_table(t);
+}
+
+// {7,1}, {7,2}, {7,3} must keep their order however many resizes follow
+static void test_bag_resize(int flags) {
+    EtsTable *t = ets_new(am("bag"), ETS_BAG, 1, flags);
+    int ok = 1;
+
+    for (Sint64 i = 1; i <= 3; i++) ets_insert(t, pair(7, i));
+    for (Sint64 k = 1000; k < 1000 + 3000 && ok; k++) {
+        ets_insert(t, pair(k, 0));
+        Sint64 v[4];
+        ok = lookup_values(t, 7, v, 4) == 3 && v[0] == 1 && v[1] == 2 && v[2] == 3;
+        if (!ok) printf("order of key 7 lost at %zu objects\n", ets_size(t));
+        heap_reset(&heap);
+    }
+    expect(ok, flags ? "bag order across resizes (write_concurrency)" : "bag order across resizes");
+    ets_delete_table(t);
+}
+
+// {1, MAX_SMALL - 1} counted up into a bignum and back down
+static void test_counter(EtsType type) {
+    EtsTable *t = ets_new(am("counter"), type, 1, 0);
+    Eterm value, list;
+
+    ets_insert(t, pair(1, MAX_SMALL - 1));
+    expect(ets_update_counter(t, make_small(1), 2, make_small(1), &heap, &value) && value == make_small(MAX_SMALL),
+           "counter stays small");
+    expect(ets_update_counter(t, make_small(1), 2, make_small(1), &heap, &value) && is_big(value) &&
+           term_eq(value, big_from_sint64(&heap, MAX_SMALL + 1)), "counter overflows into a bignum");
+    expect(ets_lookup(t, make_small(1), &heap, &list) && is_list(list) &&
+           term_eq(tuple_element(CAR(list_val(list)), 2), value), "the table holds the bignum");
+
+    Eterm big_incr = big_from_sint64(&heap, INT64_MAX);
+    expect(ets_update_counter(t, make_small(1), 2, big_incr, &heap, &value) && is_big(value),
+           "bignum counter plus a bignum");
+    Eterm back = big_from_sint64(&heap, -INT64_MAX);
+    expect(ets_update_counter(t, make_small(1), 2, back, &heap, &value) && is_big(value), "bignum counter minus a bignum");
+    expect(ets_update_counter(t, make_small(1), 2, make_small(-2), &heap, &value) && value == make_small(MAX_SMALL - 1),
+           "bignum counter back in the small range");
+    expect(ets_update_counter(t, make_small(1), 2, make_small(1), &heap, &value) && value == make_small(MAX_SMALL),
+           "small again after the bignum");
+
+    expect(!ets_update_counter(t, make_small(1), 1, make_small(1), &heap, &value), "the key is not a counter");
+    expect(!ets_update_counter(t, make_small(1), 3, make_small(1), &heap, &value), "position past the tuple");
+    expect(!ets_update_counter(t, make_small(2), 2, make_small(1), &heap, &value), "missing key");
+    expect(!ets_update_counter(t, make_small(1), 2, am("one"), &heap, &value), "increment is not an integer");
+    ets_delete_table(t);
+    heap_reset(&heap);
+}
+
+// first / next visit every key once; ordered_set in term order
+static void test_traversal(EtsType type) {
+    EtsTable *t = ets_new(am("walk"), type, 1, ETS_WRITE_CONCURRENCY);
+    enum { N = 2000 };
+    static char seen[N];
+    memset(seen, 0, sizeof seen);
+
+    // inserted in a scrambled order
+    for (Sint64 i = 0; i < N; i++) ets_insert(t, pair((i * 7919) % N, i));
+
+    usize visits = 0;
+    int ordered = 1;
+    Sint64 last = -1;
+    Eterm key;
+    for (int more = ets_first(t, &heap, &key); more; more = ets_next(t, key, &heap, &key)) {
+        Sint64 k = small_value(key);
+        if (k >= 0 && k < N) seen[k]++;
+        if (k <= last) ordered = 0;
+        last = k;
+        visits++;
+    }
+    usize once = 0;
+    for (int i = 0; i < N; i++) once += seen[i] == 1;
+    expect(visits == N && once == N, "traversal visits every key once");
+    if (type == ETS_ORDERED_SET) expect(ordered, "ordered_set traversal is in term order");
+    ets_delete_table(t);
+    heap_reset(&heap);
+}
+
+#define THREADS       4
+#define OWN_KEYS      20000     // inserted by each thread, every other one deleted again
+#define SHARED_KEYS   64        // counters, every thread bumps one per own key
+
+typedef struct {
+    EtsTable *table;
+    int id;
+} Worker;
+
+static pthread_barrier_t start;
+
+static void *run_worker(void *arg) {
+    Worker *w = arg;
+    Heap h;
+    heap_init(&h, 256);
+    pthread_barrier_wait(&start);
+
+    for (Sint64 i = 0; i < OWN_KEYS; i++) {
+        // thread keys interleave, so neighbours in the skiplist belong to different threads
+        Sint64 key = SHARED_KEYS + i * THREADS + w->id;
+        Eterm *hp = heap_alloc(&h, 3);
+        Eterm tuple = make_tuple(&hp, 2);
+        tuple_element(tuple, 1) = make_small(key);
+        tuple_element(tuple, 2) = make_small(0);
+        ets_insert(w->table, tuple);
+
+        Eterm value;
+        ets_update_counter(w->table, make_small((i * 7 + w->id) % SHARED_KEYS), 2, make_small(1), &h, &value);
+        // delete the key inserted one round before
+        if (i % 2) ets_delete(w->table, make_small(key - THREADS));
+        heap_reset(&h);
+    }
+    heap_free(&h);
+    return NULL;
+}
+
+static void test_concurrent(EtsType type, int flags) {
+    EtsTable *t = ets_new(am("shared"), type, 1, flags);
+    pthread_t tids[THREADS];
+    Worker workers[THREADS];
+
+    for (Sint64 k = 0; k < SHARED_KEYS; k++) ets_insert(t, pair(k, 0));
+    pthread_barrier_init(&start, NULL, THREADS);
+    for (int i = 0; i < THREADS; i++) {
+        workers[i].table = t;
+        workers[i].id = i;
+        pthread_create(&tids[i], NULL, run_worker, &workers[i]);
+    }
+    for (int i = 0; i < THREADS; i++) pthread_join(tids[i], NULL);
+    pthread_barrier_destroy(&start);
+
+    Sint64 total = 0, v[1];
+    for (Sint64 k = 0; k < SHARED_KEYS; k++) {
+        if (lookup_values(t, k, v, 1) == 1) total += v[0];
+    }
+    heap_reset(&heap);
+
+    expect(total == THREADS * OWN_KEYS, "no counter increment is lost");
+
+    // the keys of odd rounds are left
+    usize left = SHARED_KEYS + THREADS * (OWN_KEYS / 2);
+    usize walked = 0;
+    Eterm key;
+    for (int more = ets_first(t, &heap, &key); more; more = ets_next(t, key, &heap, &key)) walked++;
+    expect(ets_size(t) == left && walked == left, "concurrent inserts and deletes leave the right keys");
+    ets_delete_table(t);
+    heap_reset(&heap);
+}
+
+static void test_named(void) {
+    EtsTable *t = ets_new(am("ets_test_named"), ETS_SET, 1, ETS_NAMED_TABLE);
+    expect(t && ets_whereis(am("ets_test_named")) == t, "named table is found");
+    expect(ets_new(am("ets_test_named"), ETS_SET, 1, ETS_NAMED_TABLE) == NULL, "name taken twice");
+    ets_delete_table(t);
+    expect(ets_whereis(am("ets_test_named")) == NULL, "deleted table is gone");
+}
+
+int main(void) {
+    heap_init(&heap, 4096);
+
+    test_set(ETS_SET);
+    test_set(ETS_ORDERED_SET);
+    test_bag();
+    test_counter(ETS_SET);
+    test_counter(ETS_ORDERED_SET);
+    test_bag_resize(0);
+    test_bag_resize(ETS_WRITE_CONCURRENCY);
+    test_traversal(ETS_SET);
+    test_traversal(ETS_BAG);
+    test_traversal(ETS_ORDERED_SET);
+    test_named();
+    test_concurrent(ETS_SET, ETS_WRITE_CONCURRENCY);
+    test_concurrent(ETS_ORDERED_SET, 0);
+    test_concurrent(ETS_ORDERED_SET, ETS_WRITE_CONCURRENCY);
+    test_concurrent(ETS_ORDERED_SET, ETS_READ_CONCURRENCY | ETS_WRITE_CONCURRENCY);
+
+    heap_free(&heap);
+    printf("%s: %d failed\n", failed ? "FAIL" : "ok", failed);
+    return failed ? 1 : 0;
+}
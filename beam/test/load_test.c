@@ -0,0 +1,129 @@
+/*
+Loader tests.
+
+Integer operands: decodes "move Int x0; int_code_end" for integers around
+the edges of the small range and checks the term operand_term() makes of
+them. Integers wider than a small must become bignums, not be cut to 60 bits.
+
+Validation: one function f/1 with different bodies, checks which ones
+validate_module() accepts.
+
+usage: load_test (exit status 0 if every case passes)
+*/
+#include "load.h"
+#include "big.h"
+#include "validate.h"
+
+// extended form of an 8 byte TAG_i operand: (8 - 2) << 5 | extended | tag
+#define EXT8_INTEGER 0xD9
+
+static int check(Sint64 value) {
+    byte chunk[20 + 1 + 1 + 8 + 1 + 1] = {
+        0, 0, 0, 16,        // header size
+        0, 0, 0, 0,         // instruction set
+        0, 0, 0, MAX_OPCODE,
+        0, 0, 0, 1,         // labels
+        0, 0, 0, 0,         // functions
+    };
+    usize n = 20;
+    chunk[n++] = op_move;
+    chunk[n++] = EXT8_INTEGER;
+    for (int i = 7; i >= 0; i--) chunk[n++] = (byte)((Uint64)value >> (8 * i));
+    chunk[n++] = (0 << 4) | TAG_x;
+    chunk[n++] = op_int_code_end;
+
+    BeamModule bm = { 0 };
+    if (!parse_code(&bm.code, chunk, (Uint32)n) || bm.code.instr_count != 2) {
+        printf("FAIL %" PRId64 ": code not decoded\n", value);
+        free_code(&bm.code);
+        return 0;
+    }
+
+    Heap heap;
+    heap_init(&heap, 0);
+    Eterm expected = IS_SSMALL(value) ? make_small(value) : big_from_sint64(&heap, value);
+    Eterm got;
+    int ok = operand_term(&bm, instr_arg(&bm.code, &bm.code.instrs[0], 0), &got) && term_eq(got, expected);
+    if (!ok) {
+        printf("FAIL %" PRId64 ": got ", value);
+        print_term(stdout, got);
+        printf("\n");
+    }
+    heap_free(&heap);
+    free_code(&bm.code);
+    return ok;
+}
+
+#define U(n)    (byte)(((n) << 4) | TAG_u)
+#define A(n)    (byte)(((n) << 4) | TAG_a)
+#define X(n)    (byte)(((n) << 4) | TAG_x)
+#define F(n)    (byte)(((n) << 4) | TAG_f)
+#define I(n)    (byte)(((n) << 4) | TAG_i)
+#define LIST    (byte)((1 << 4) | TAG_z)
+#define ALLOC   (byte)((3 << 4) | TAG_z)
+#define FR      (byte)((2 << 4) | TAG_z)
+
+// "label 1; func_info m f 1; label 2; body; int_code_end"
+static int check_body(const char *what, const byte *body, usize body_size, int valid) {
+    byte chunk[256] = {
+        0, 0, 0, 16,
+        0, 0, 0, 0,
+        0, 0, 0, MAX_OPCODE,
+        0, 0, 0, 3,
+        0, 0, 0, 1,
+        op_label, U(1), op_func_info, A(1), A(2), U(1), op_label, U(2),
+    };
+    usize n = 28;
+    memcpy(chunk + n, body, body_size);
+    n += body_size;
+    chunk[n++] = op_int_code_end;
+
+    char m[] = "m", f[] = "f";
+    Atom atoms[2] = { { 0, 1, m, 0 }, { 1, 1, f, 0 } };
+    BeamModule bm = { 0 };
+    bm.module_name = m;
+    bm.atom_table = atoms;
+    bm.atom_count = 2;
+
+    int ok = parse_code(&bm.code, chunk, (Uint32)n) && validate_module(&bm) == valid;
+    if (!ok) printf("FAIL %s: expected %s\n", what, valid ? "valid" : "rejected");
+    free_code(&bm.code);
+    return ok;
+}
+
+int main(void) {
+    const Sint64 cases[] = {
+        0, -1, MAX_SMALL, MIN_SMALL,
+        (Sint64)1 << 59, -((Sint64)1 << 59) - 1,
+        INT64_MAX, INT64_MIN,
+    };
+    int failed = 0;
+    for (usize i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (!check(cases[i])) failed++;
+    }
+    const byte ret[] = { op_move, X(0), X(1), op_return };
+    const byte dead_x[] = { op_move, X(1), X(0), op_return };
+    const byte obsolete[] = { op_m_plus, F(0), X(0), X(0), X(0), op_return };
+    const byte no_return[] = { op_move, X(0), X(1) };
+    const byte after_wait[] = { op_wait_timeout, F(2), I(10), op_timeout, op_move, A(1), X(0), op_return };
+    // fun with x0 in its environment: 2 words and 1 for x0
+    const byte fun[] = { op_test_heap, ALLOC, U(2), U(0), U(1), U(2), U(1), U(1),
+                         op_make_fun3, U(0), X(0), LIST, U(1), X(0), op_return };
+    const byte fun_no_heap[] = { op_make_fun3, U(0), X(0), LIST, U(1), X(0), op_return };
+    const byte record_no_heap[] = { op_update_record, A(1), U(3), X(0), X(0), LIST, U(2), U(2), A(2), op_return };
+    const byte float_reg[] = { op_move, FR, U(0), X(0), op_return };
+    const byte x_after_wait[] = { op_move, X(0), X(1), op_wait_timeout, F(2), I(10), op_timeout, op_move, X(1), X(0), op_return };
+    if (!check_body("move x0 x1; return", ret, sizeof ret, 1)) failed++;
+    if (!check_body("move x1 x0 (x1 not live)", dead_x, sizeof dead_x, 0)) failed++;
+    if (!check_body("m_plus (obsolete)", obsolete, sizeof obsolete, 0)) failed++;
+    if (!check_body("move x0 x1 (falls off the end)", no_return, sizeof no_return, 0)) failed++;
+    if (!check_body("wait_timeout; timeout; move a x0; return", after_wait, sizeof after_wait, 1)) failed++;
+    if (!check_body("move x0 x1; wait_timeout; move x1 x0 (x1 lost)", x_after_wait, sizeof x_after_wait, 0)) failed++;
+    if (!check_body("move fr0 x0", float_reg, sizeof float_reg, 0)) failed++;
+    if (!check_body("test_heap [words 1, funs 1]; make_fun3", fun, sizeof fun, 1)) failed++;
+    if (!check_body("make_fun3 (no heap reserved)", fun_no_heap, sizeof fun_no_heap, 0)) failed++;
+    if (!check_body("update_record (no heap reserved)", record_no_heap, sizeof record_no_heap, 0)) failed++;
+
+    printf("%s: %d failed\n", failed ? "FAIL" : "ok", failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,183 @@
+/*
+Map tests.
+
+get / put / update on flatmaps and on HAMTs, across the flatmap limit in
+both directions of growth, with keys of several types (1 and 1.0 are
+different keys). Updates leave the old map untouched; value updates of a
+flatmap share its key tuple. Maps with equal contents built in different
+orders are equal word for word, so term_eq, term_hash and map_cmp agree.
+Also the instruction paths: get_map_elements and put_map_assoc /
+put_map_exact with sorted and unsorted key lists.
+
+usage: map_test (exit status 0 if every case passes)
+*/
+#include "map.h"
+#include "atom.h"
+#include "big.h"
+
+static int failed;
+static Heap heap;
+
+static void expect(int ok, const char *what) {
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failed++;
+    }
+}
+
+// key i: smalls, atoms, bignums and tuples in turn
+static Eterm key_of(usize i) {
+    switch (i % 4) {
+    case 0: return make_small((Sint64)i);
+    case 1: {
+        char name[32];
+        snprintf(name, sizeof name, "key_%zu", i);
+        return am(name);
+    }
+    case 2: return big_from_sint64(&heap, MAX_SMALL + 1 + (Sint64)i);
+    default: {
+        Eterm *hp = heap_alloc(&heap, 3);
+        Eterm tuple = make_tuple(&hp, 2);
+        tuple_element(tuple, 1) = make_small((Sint64)i);
+        tuple_element(tuple, 2) = NIL;
+        return tuple;
+    }
+    }
+}
+
+static void test_flatmap(void) {
+    Eterm m = map_new(&heap);
+    expect(is_flatmap(m) && map_size(m) == 0, "new map is an empty flatmap");
+    expect(!is_value(map_get(m, am("a"))), "get from the empty map");
+
+    Eterm m1 = map_put(&heap, m, am("a"), make_small(1));
+    Eterm m2 = map_put(&heap, m1, am("b"), make_small(2));
+    expect(map_size(m2) == 2 && map_get(m2, am("a")) == make_small(1) && map_get(m2, am("b")) == make_small(2),
+           "put and get");
+    expect(map_size(m1) == 1 && !is_value(map_get(m1, am("b"))), "put leaves the old map alone");
+
+    Eterm m3 = map_update(&heap, m2, am("a"), make_small(10));
+    expect(map_get(m3, am("a")) == make_small(10) && map_get(m2, am("a")) == make_small(1), "update");
+    expect(flatmap_keys(m3) == flatmap_keys(m2), "value update shares the key tuple");
+    expect(!is_value(map_update(&heap, m2, am("c"), make_small(3))), "update of a missing key");
+    expect(map_size(map_put(&heap, m2, am("a"), make_small(5))) == 2, "put over an existing key");
+
+    // =:= keys: 1 and 1.0 differ
+    Eterm *hp = heap_alloc(&heap, 2);
+    Eterm one_float = make_float(&hp, 1.0);
+    Eterm m4 = map_put(&heap, map_put(&heap, m, make_small(1), am("int")), one_float, am("float"));
+    expect(map_size(m4) == 2 && map_get(m4, make_small(1)) == am("int") && map_get(m4, one_float) == am("float"),
+           "1 and 1.0 are different keys");
+
+    Eterm kvs[] = { am("x"), make_small(1), am("y"), make_small(2), am("x"), make_small(3) };
+    Eterm m5 = map_from_pairs(&heap, kvs, 3);
+    expect(map_size(m5) == 2 && map_get(m5, am("x")) == make_small(3), "from_pairs: the last of equal keys wins");
+    heap_reset(&heap);
+}
+
+// grows one key at a time through the flatmap limit into a deep HAMT
+static void test_growth(void) {
+    enum { N = 5000 };
+    Eterm maps[N + 1];
+    int ok = 1;
+
+    maps[0] = map_new(&heap);
+    for (usize i = 0; i < N; i++) {
+        maps[i + 1] = map_put(&heap, maps[i], key_of(i), make_small((Sint64)i));
+        if (map_size(maps[i + 1]) != i + 1) ok = 0;
+    }
+    expect(ok, "size grows by one per new key");
+    expect(is_flatmap(maps[MAP_SMALL_LIMIT]) && is_hashmap(maps[MAP_SMALL_LIMIT + 1]),
+           "a flatmap turns into a HAMT past MAP_SMALL_LIMIT");
+
+    ok = 1;
+    for (usize i = 0; i < N; i++) {
+        if (map_get(maps[N], key_of(i)) != make_small((Sint64)i)) ok = 0;
+    }
+    expect(ok, "every key is found in the HAMT");
+
+    // older versions are untouched
+    ok = 1;
+    for (usize v = 0; v <= N; v += 97) {
+        for (usize i = 0; i < N; i += 13) {
+            Eterm val = map_get(maps[v], key_of(i));
+            if (i < v ? val != make_small((Sint64)i) : is_value(val)) ok = 0;
+        }
+    }
+    expect(ok, "older versions keep their keys");
+
+    Eterm m = maps[N];
+    for (usize i = 0; i < N; i += 3) m = map_update(&heap, m, key_of(i), am("updated"));
+    ok = map_size(m) == N;
+    for (usize i = 0; i < N; i++) {
+        if (map_get(m, key_of(i)) != (i % 3 ? make_small((Sint64)i) : am("updated"))) ok = 0;
+    }
+    expect(ok, "HAMT update");
+    expect(!is_value(map_update(&heap, m, am("missing"), NIL)), "HAMT update of a missing key");
+    heap_reset(&heap);
+}
+
+// the same keys in two orders give identical maps
+static void test_canonical(usize n) {
+    Eterm up = map_new(&heap), down = map_new(&heap);
+    for (usize i = 0; i < n; i++) {
+        up = map_put(&heap, up, key_of(i), make_small((Sint64)i));
+        down = map_put(&heap, down, key_of(n - 1 - i), make_small((Sint64)(n - 1 - i)));
+    }
+    expect(term_eq(up, down), "insertion order does not change a map");
+    expect(term_hash(up) == term_hash(down), "equal maps hash alike");
+    expect(map_cmp(up, down, 1) == 0, "equal maps compare equal");
+
+    Eterm other = map_put(&heap, up, key_of(0), am("changed"));
+    expect(!term_eq(up, other) && map_cmp(up, other, 1) != 0, "a changed value makes maps differ");
+
+    Eterm *kvs = malloc(2 * n * sizeof(Eterm));
+    map_to_pairs(up, kvs);
+    int sorted = 1;
+    for (usize i = 1; i < n; i++) {
+        if (term_cmp_exact(kvs[2 * (i - 1)], kvs[2 * i]) >= 0) sorted = 0;
+    }
+    expect(sorted, "map_to_pairs is sorted by key");
+    expect(term_eq(map_from_pairs(&heap, kvs, n), up), "map_from_pairs of map_to_pairs");
+    free(kvs);
+    heap_reset(&heap);
+}
+
+static void test_instructions(int big) {
+    usize n = big ? 100 : 8;
+    Eterm m = map_new(&heap);
+    for (usize i = 0; i < n; i++) m = map_put(&heap, m, key_of(i), make_small((Sint64)i));
+
+    Eterm keys[4] = { key_of(5), key_of(1), key_of(7), key_of(2) };
+    Eterm vals[4];
+    expect(map_get_elements(m, keys, 4, vals) && vals[0] == make_small(5) && vals[1] == make_small(1) &&
+           vals[2] == make_small(7) && vals[3] == make_small(2), "get_map_elements with unsorted keys");
+    map_sort_pairs(keys, 4, 1);
+    expect(map_get_elements(m, keys, 4, vals), "get_map_elements with sorted keys");
+    keys[3] = am("missing");
+    expect(!map_get_elements(m, keys, 4, vals), "get_map_elements with a missing key");
+
+    Eterm kvs[] = { key_of(3), am("three"), am("new"), am("value") };
+    Eterm assoc = map_put_pairs(&heap, m, kvs, 2, 0);
+    expect(map_size(assoc) == n + 1 && map_get(assoc, key_of(3)) == am("three") &&
+           map_get(assoc, am("new")) == am("value"), "put_map_assoc");
+    expect(!is_value(map_put_pairs(&heap, m, kvs, 2, 1)), "put_map_exact with a missing key");
+    Eterm exact = map_put_pairs(&heap, m, kvs, 1, 1);
+    expect(map_size(exact) == n && map_get(exact, key_of(3)) == am("three"), "put_map_exact");
+    heap_reset(&heap);
+}
+
+int main(void) {
+    heap_init(&heap, 4096);
+
+    test_flatmap();
+    test_growth();
+    test_canonical(MAP_SMALL_LIMIT);
+    test_canonical(3000);
+    test_instructions(0);
+    test_instructions(1);
+
+    heap_free(&heap);
+    printf("%s: %d failed\n", failed ? "FAIL" : "ok", failed);
+    return failed ? 1 : 0;
+}
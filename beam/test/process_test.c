@@ -0,0 +1,173 @@
+/*
+Process table tests.
+
+Exited pids do not resolve, also once their slot runs the next process. A
+process pinned by process_lookup keeps its PCB until the pin is released,
+however often the pool spawns and exits meanwhile. A recycled PCB keeps one
+initial sized heap fragment, whatever its last process grew the heap to.
+
+Concurrency: one thread spawns and exits while others look up its pids; a
+pinned process may exit, but its PCB must not carry another pid meanwhile.
+
+usage: process_test (exit status 0 if every case passes)
+*/
+#include <pthread.h>
+#include "process.h"
+
+static int failed;
+
+static void expect(int ok, const char *what) {
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failed++;
+    }
+}
+
+static void test_lookup(ProcessPool *pool) {
+    Process *p = process_spawn(pool);
+    Eterm pid = p->pid;
+
+    Process *q = process_lookup(pid);
+    expect(q == p, "lookup finds a live process");
+    process_release(q);
+    expect(process_lookup(make_small(1)) == NULL, "lookup of a non pid");
+
+    process_exit(pool, p);
+    expect(process_lookup(pid) == NULL, "an exited pid does not resolve");
+
+    // the pool hands the same PCB out again, under a new pid
+    Process *next = process_spawn(pool);
+    expect(next == p && next->pid != pid, "a recycled slot gets a new pid");
+    expect(process_lookup(pid) == NULL, "the old pid does not reach the next process");
+    process_exit(pool, next);
+}
+
+static void test_pinned_exit(ProcessPool *pool) {
+    Process *p = process_spawn(pool);
+    Eterm pid = p->pid;
+    Process *pinned = process_lookup(pid);
+
+    process_exit(pool, p);
+    expect(process_lookup(pid) == NULL, "an exited pid does not resolve while pinned");
+
+    int reused = 0;
+    for (int i = 0; i < 2 * PROCESS_POOL_MAX; i++) {
+        Process *q = process_spawn(pool);
+        reused |= q == pinned;
+        process_exit(pool, q);
+    }
+    expect(!reused, "a pinned PCB is not handed out again");
+    expect(pinned->pid == NIL, "a pinned exited process has no pid");
+
+    // the release recycles it into the global stack, an empty pool takes it from there
+    process_release(pinned);
+    ProcessPool other;
+    process_pool_init(&other, 1);
+    Process *q = process_spawn(&other);
+    expect(q == pinned, "the last release recycles the PCB");
+    process_exit(&other, q);
+    process_pool_destroy(&other);
+}
+
+static void test_heap_recycled(ProcessPool *pool) {
+    Process *p = process_spawn(pool);
+    for (int i = 0; i < 10; i++) heap_alloc(&p->heap, PROCESS_HEAP_WORDS);
+    process_exit(pool, p);
+
+    Process *q = process_spawn(pool);
+    expect(q == p, "the grown process is recycled");
+    expect(q->heap.frags && !q->heap.frags->next && q->heap.frags->size == PROCESS_HEAP_WORDS &&
+           q->heap.frags->used == 0, "a recycled PCB keeps one initial sized fragment");
+    process_exit(pool, q);
+}
+
+static void test_full(void) {
+    ProcessPool pool;
+    Process *ps[4];
+
+    process_table_init(4);
+    process_pool_init(&pool, 0);
+    for (int i = 0; i < 4; i++) ps[i] = process_spawn(&pool);
+    expect(ps[3] && process_spawn(&pool) == NULL, "spawn fails when the table is full");
+    for (int i = 0; i < 4; i++) process_exit(&pool, ps[i]);
+    expect(process_spawn(&pool) != NULL, "spawn succeeds again after an exit");
+    process_pool_destroy(&pool);
+    process_table_destroy();
+}
+
+#define LOOKUPS   200000
+#define READERS   3
+#define WINDOW    16
+
+static _Atomic Eterm shared_pids[WINDOW];
+static _Atomic int done;
+
+static void *run_reader(void *arg) {
+    usize *wrong = arg;
+    for (usize i = 0; i < LOOKUPS && !atomic_load(&done); i++) {
+        Eterm pid = atomic_load(&shared_pids[i % WINDOW]);
+        Process *p = process_lookup(pid);
+        if (!p) continue;
+        Eterm now = atomic_load(&p->pid);
+        if (now != pid && now != NIL) (*wrong)++;
+        process_release(p);
+    }
+    return NULL;
+}
+
+static void test_concurrent(void) {
+    ProcessPool pool;
+    Process *live[WINDOW];
+    pthread_t tids[READERS];
+    usize wrong[READERS] = { 0 };
+
+    process_table_init(1024);
+    process_pool_init(&pool, 0);
+    for (int i = 0; i < WINDOW; i++) {
+        live[i] = process_spawn(&pool);
+        atomic_store(&shared_pids[i], live[i]->pid);
+    }
+    atomic_store(&done, 0);
+    for (int i = 0; i < READERS; i++) pthread_create(&tids[i], NULL, run_reader, &wrong[i]);
+
+    for (usize i = 0; i < LOOKUPS; i++) {
+        int k = (int)(i % WINDOW);
+        process_exit(&pool, live[k]);
+        live[k] = process_spawn(&pool);
+        // a pinned PCB is missing from the pool for a while, never from the table
+        if (!live[k]) break;
+        atomic_store(&shared_pids[k], live[k]->pid);
+    }
+    atomic_store(&done, 1);
+
+    usize total = 0;
+    for (int i = 0; i < READERS; i++) {
+        pthread_join(tids[i], NULL);
+        total += wrong[i];
+    }
+    expect(total == 0, "a pinned PCB is not handed to another process");
+
+    for (int i = 0; i < WINDOW; i++) {
+        if (live[i]) process_exit(&pool, live[i]);
+    }
+    process_pool_destroy(&pool);
+    process_table_destroy();
+}
+
+int main(void) {
+    ProcessPool pool;
+
+    process_table_init(1024);
+    process_pool_init(&pool, 0);
+    test_lookup(&pool);
+    test_pinned_exit(&pool);
+    test_heap_recycled(&pool);
+    process_pool_destroy(&pool);
+    process_table_destroy();
+
+    test_full();
+    test_concurrent();
+
+    printf("%s: %d failed\n", failed ? "FAIL" : "ok", failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+/*
+Timer wheel tests.
+
+Timers on every level (and in the overflow list) must fire at their
+deadline, not a tick earlier and not later. Cancelled timers never fire,
+also when a callback cancels a timer of the slot being expired. A callback
+that re-arms its timer for a deadline that has passed fires once per tick
+and does not keep timer_wheel_advance busy.
+
+usage: timer_test (exit status 0 if every case passes)
+*/
+#include "timer.h"
+
+// a callback re-arming more often than this within one advance is stuck
+#define REARM_LIMIT 1000
+
+typedef struct {
+    Timer timer;
+    TimerWheel *wheel;
+    usize fired;
+    Timer *cancel;          // cancelled by the callback
+    int rearm;              // re-armed by the callback for a deadline in the past
+} Probe;
+
+static int failed;
+
+static void expect(int ok, const char *what) {
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failed++;
+    }
+}
+
+static void on_fire(void *arg) {
+    Probe *p = arg;
+    p->fired++;
+    if (p->cancel) timer_wheel_cancel(p->wheel, p->cancel);
+    if (p->rearm && p->fired < REARM_LIMIT) timer_wheel_insert(p->wheel, &p->timer, 0);
+}
+
+static void probe_init(Probe *p, TimerWheel *w) {
+    memset(p, 0, sizeof *p);
+    p->wheel = w;
+    timer_init(&p->timer, on_fire, p);
+}
+
+static void test_deadlines(void) {
+    static TimerWheel w;
+    const Uint64 deadlines[] = {
+        0, 1, 63, 64, 65, 4095, 4096, 100000, 3000000, 200000000,
+        // overflow list: beyond 64^5 ticks
+        ((Uint64)1 << 30) + 7,
+    };
+    enum { N = sizeof(deadlines) / sizeof(deadlines[0]) };
+    Probe probes[N];
+
+    timer_wheel_init(&w, 0);
+    for (int i = 0; i < N; i++) {
+        probe_init(&probes[i], &w);
+        timer_wheel_insert(&w, &probes[i].timer, deadlines[i]);
+    }
+
+    for (int i = 0; i < N; i++) {
+        Uint64 next;
+        expect(timer_wheel_next_deadline(&w, &next) && next == deadlines[i], "next_deadline is the earliest timer");
+        if (deadlines[i] > 0) timer_wheel_advance(&w, deadlines[i] - 1);
+        expect(probes[i].fired == 0, "timer fires early");
+        timer_wheel_advance(&w, deadlines[i]);
+        expect(probes[i].fired == 1, "timer fires at its deadline");
+        for (int k = i + 1; k < N; k++) expect(probes[k].fired == 0, "later timer fires early");
+    }
+    expect(!timer_wheel_next_deadline(&w, &(Uint64){ 0 }), "wheel is empty");
+}
+
+static void test_cancel(void) {
+    static TimerWheel w;
+    Probe a, b, c;
+
+    timer_wheel_init(&w, 100);
+    probe_init(&a, &w);
+    probe_init(&b, &w);
+    probe_init(&c, &w);
+    timer_wheel_insert(&w, &a.timer, 110);
+    timer_wheel_insert(&w, &b.timer, 110);
+    timer_wheel_insert(&w, &c.timer, 5000);
+
+    // a fires first and cancels b, which sits in the same slot
+    a.cancel = &b.timer;
+    expect(timer_wheel_cancel(&w, &c.timer) == 1, "cancel an armed timer");
+    expect(timer_wheel_cancel(&w, &c.timer) == 0, "cancel twice");
+
+    expect(timer_wheel_advance(&w, 10000) == 1, "one timer fires");
+    expect(a.fired == 1 && b.fired == 0 && c.fired == 0, "cancelled timers do not fire");
+    expect(timer_wheel_cancel(&w, &a.timer) == 0, "cancel a fired timer");
+}
+
+static void test_rearm_in_the_past(void) {
+    static TimerWheel w;
+    Probe p;
+
+    timer_wheel_init(&w, 0);
+    probe_init(&p, &w);
+    p.rearm = 1;
+    timer_wheel_insert(&w, &p.timer, 5);
+
+    // fires at 5, then again on every tick up to 10
+    usize fired = timer_wheel_advance(&w, 10);
+    expect(p.fired < REARM_LIMIT, "re-armed timer keeps advance busy");
+    expect(fired == 6 && p.fired == 6, "re-armed timer fires once per tick");
+
+    timer_wheel_advance(&w, 11);
+    expect(p.fired == 7, "re-armed timer fires on the next advance");
+    timer_wheel_cancel(&w, &p.timer);
+}
+
+int main(void) {
+    test_deadlines();
+    test_cancel();
+    test_rearm_in_the_past();
+
+    printf("%s: %d failed\n", failed ? "FAIL" : "ok", failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,232 @@
+#include "timer.h"
+
+#define LEVEL_SHIFT(l) ((l) * TW_SLOT_BITS)
+
+static void list_init(Timer *head) {
+    head->next = head;
+    head->prev = head;
+}
+
+static int list_empty(const Timer *head) {
+    return head->next == head;
+}
+
+static void list_append(Timer *head, Timer *t) {
+    t->prev = head->prev;
+    t->next = head;
+    head->prev->next = t;
+    head->prev = t;
+}
+
+static void list_unlink(Timer *t) {
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->next = t->prev = NULL;
+}
+
+void timer_wheel_init(TimerWheel *w, Uint64 now) {
+    w->now = now;
+    w->count = 0;
+    for (int l = 0; l < TW_LEVELS; l++) {
+        w->occupied[l] = 0;
+        for (int s = 0; s < TW_SLOTS; s++) list_init(&w->slots[l][s]);
+    }
+    list_init(&w->overflow);
+}
+
+void timer_init(Timer *t, TimerCallback callback, void *arg) {
+    t->next = t->prev = NULL;
+    t->deadline = 0;
+    t->callback = callback;
+    t->arg = arg;
+    t->active = 0;
+}
+
+// links t into the slot matching its distance from w->now
+static void place(TimerWheel *w, Timer *t) {
+    Uint64 deadline = t->deadline < w->now ? w->now : t->deadline;
+    Uint64 delta = deadline - w->now;
+
+    for (int l = 0; l < TW_LEVELS; l++) {
+        if (delta < ((Uint64)1 << LEVEL_SHIFT(l + 1))) {
+            int s = (int)((deadline >> LEVEL_SHIFT(l)) & TW_SLOT_MASK);
+            t->level = (Uint16)l;
+            t->slot = (Uint16)s;
+            list_append(&w->slots[l][s], t);
+            w->occupied[l] |= (Uint64)1 << s;
+            return;
+        }
+    }
+
+    t->level = TW_LEVELS;
+    t->slot = 0;
+    list_append(&w->overflow, t);
+}
+
+void timer_wheel_insert(TimerWheel *w, Timer *t, Uint64 deadline) {
+    if (t->active) timer_wheel_cancel(w, t);
+    t->deadline = deadline;
+    t->active = 1;
+    place(w, t);
+    w->count++;
+}
+
+int timer_wheel_cancel(TimerWheel *w, Timer *t) {
+    if (!t->active) return 0;
+
+    list_unlink(t);
+    if (t->level < TW_LEVELS && list_empty(&w->slots[t->level][t->slot])) {
+        w->occupied[t->level] &= ~((Uint64)1 << t->slot);
+    }
+    t->active = 0;
+    w->count--;
+    return 1;
+}
+
+// moves every timer of one slot down to where it belongs now
+static void cascade(TimerWheel *w, int level, int slot) {
+    Timer *head = &w->slots[level][slot];
+    Timer pending;
+
+    if (list_empty(head)) return;
+
+    // detach the whole slot first, place() may link into the same slot again
+    pending.next = head->next;
+    pending.prev = head->prev;
+    pending.next->prev = &pending;
+    pending.prev->next = &pending;
+    list_init(head);
+    w->occupied[level] &= ~((Uint64)1 << slot);
+
+    while (!list_empty(&pending)) {
+        Timer *t = pending.next;
+        list_unlink(t);
+        place(w, t);
+    }
+}
+
+static void cascade_overflow(TimerWheel *w) {
+    Timer pending;
+
+    if (list_empty(&w->overflow)) return;
+
+    pending.next = w->overflow.next;
+    pending.prev = w->overflow.prev;
+    pending.next->prev = &pending;
+    pending.prev->next = &pending;
+    list_init(&w->overflow);
+
+    while (!list_empty(&pending)) {
+        Timer *t = pending.next;
+        list_unlink(t);
+        place(w, t);
+    }
+}
+
+// called when w->now is at the start of a level 0 round
+static void cascade_levels(TimerWheel *w) {
+    for (int l = 1; l < TW_LEVELS; l++) {
+        int slot = (int)((w->now >> LEVEL_SHIFT(l)) & TW_SLOT_MASK);
+        cascade(w, l, slot);
+        // the next level only moves when this one wrapped around
+        if (slot != 0) return;
+    }
+    cascade_overflow(w);
+}
+
+/*
+Fires the timers of one level 0 slot, called with w->now already past it.
+The slot is detached first: a callback that re-arms its timer for a
+deadline that has passed lands in the next tick, not back in this list.
+*/
+static usize expire_slot(TimerWheel *w, int slot) {
+    Timer *head = &w->slots[0][slot];
+    Timer pending;
+    usize fired = 0;
+
+    pending.next = head->next;
+    pending.prev = head->prev;
+    pending.next->prev = &pending;
+    pending.prev->next = &pending;
+    list_init(head);
+    w->occupied[0] &= ~((Uint64)1 << slot);
+
+    while (!list_empty(&pending)) {
+        Timer *t = pending.next;
+        list_unlink(t);
+        t->active = 0;
+        w->count--;
+        fired++;
+        // the callback may re-arm t, insert other timers or cancel pending ones
+        t->callback(t->arg);
+    }
+    return fired;
+}
+
+usize timer_wheel_advance(TimerWheel *w, Uint64 now) {
+    usize fired = 0;
+
+    while (w->now <= now) {
+        if (w->count == 0) {
+            w->now = now + 1;
+            break;
+        }
+
+        int index = (int)(w->now & TW_SLOT_MASK);
+        if (index == 0) cascade_levels(w);
+
+        if (!(w->occupied[0] & ((Uint64)1 << index))) {
+            // skip empty ticks up to the next occupied slot or the end of this round
+            Uint64 ahead = w->occupied[0] >> index;
+            Uint64 step = ahead ? (Uint64)__builtin_ctzll(ahead) : (Uint64)(TW_SLOTS - index);
+            if (w->now + step > now + 1) step = now + 1 - w->now;
+            w->now += step;
+            continue;
+        }
+
+        w->now++;
+        fired += expire_slot(w, index);
+    }
+    return fired;
+}
+
+static Uint64 earliest_in(const Timer *head, Uint64 best) {
+    for (const Timer *t = head->next; t != head; t = t->next) {
+        if (t->deadline < best) best = t->deadline;
+    }
+    return best;
+}
+
+/*
+The first occupied slot of each level (in wheel order from the current
+position) holds that level's earliest timers. On higher levels the slot at
+the current position only holds timers a full round ahead once it has been
+cascaded, so the search starts one past it. A timer linked on a higher level can still be due before
+one on a lower level, so every level is looked at.
+*/
+int timer_wheel_next_deadline(const TimerWheel *w, Uint64 *deadline_out) {
+    if (w->count == 0) return 0;
+
+    Uint64 best = UINT64_MAX;
+
+    for (int l = 0; l < TW_LEVELS; l++) {
+        Uint64 bits = w->occupied[l];
+        if (!bits) continue;
+
+        int pos = (int)((w->now >> LEVEL_SHIFT(l)) & TW_SLOT_MASK);
+        // at a window boundary the current slot has not been cascaded yet
+        int pending = (w->now & (((Uint64)1 << LEVEL_SHIFT(l)) - 1)) == 0;
+        int start = pending ? pos : (pos + 1) & TW_SLOT_MASK;
+        // rotate so that bit 0 is the start slot
+        Uint64 rotated = start ? (bits >> start) | (bits << (TW_SLOTS - start)) : bits;
+        int slot = (start + __builtin_ctzll(rotated)) & TW_SLOT_MASK;
+
+        best = earliest_in(&w->slots[l][slot], best);
+    }
+    best = earliest_in(&w->overflow, best);
+
+    // expired but not yet processed timers are due right away
+    if (best < w->now) best = w->now;
+    *deadline_out = best;
+    return 1;
+}
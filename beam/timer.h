@@ -0,0 +1,59 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "binary_parsing_helpers.h"
+#include "term.h"
+
+/*
+Hierarchical timing wheel.
+
+Each scheduler owns one wheel and is the only thread touching it. Time is
+counted in ticks (1 ms). Level 0 has one slot per tick, every higher level
+covers 64 times the span of the level below. A timer is placed on the lowest
+level whose span covers its distance from now; when time reaches the start of
+a higher level slot, that slot is cascaded down into the levels below.
+
+Timers are intrusive (the caller owns the Timer), so insert and cancel are
+O(1) and never allocate.
+*/
+#define TW_SLOT_BITS 6
+#define TW_SLOTS     (1 << TW_SLOT_BITS)
+#define TW_SLOT_MASK (TW_SLOTS - 1)
+#define TW_LEVELS    5      // 64^5 ms, about 12 days; later timers wait in an overflow list
+
+typedef void (*TimerCallback)(void *arg);
+
+typedef struct timer {
+    struct timer *next;
+    struct timer *prev;
+    Uint64 deadline;        // absolute tick
+    TimerCallback callback;
+    void *arg;
+    Uint16 level;           // where the timer is linked, TW_LEVELS = overflow list
+    Uint16 slot;
+    int active;
+} Timer;
+
+typedef struct {
+    Uint64 now;                             // next tick to be processed
+    Timer slots[TW_LEVELS][TW_SLOTS];       // list heads
+    Uint64 occupied[TW_LEVELS];             // bit i set if slots[level][i] is not empty
+    Timer overflow;
+    usize count;
+} TimerWheel;
+
+void timer_wheel_init(TimerWheel *w, Uint64 now);
+
+void timer_init(Timer *t, TimerCallback callback, void *arg);
+// arms t to fire at the absolute tick deadline (a deadline in the past fires on the next advance)
+void timer_wheel_insert(TimerWheel *w, Timer *t, Uint64 deadline);
+// returns 1 if the timer was armed, 0 if it already fired or was never set
+int timer_wheel_cancel(TimerWheel *w, Timer *t);
+
+// runs every timer with deadline <= now, returns how many fired
+usize timer_wheel_advance(TimerWheel *w, Uint64 now);
+
+// stores the earliest armed deadline, returns 0 if the wheel is empty
+int timer_wheel_next_deadline(const TimerWheel *w, Uint64 *deadline_out);
@@ -0,0 +1,1087 @@
+#include "validate.h"
+#include <stdarg.h>
+
+/*
+Operand roles, one character per operand of an instruction:
+
+s  source: x registers must be live, y registers initialized
+d  destination register (x, y or float register)
+l  branch target, label 0 or an atom (no_fail, resume) means no branch
+r  label referenced without jumping to it (recv_mark / recv_set)
+c  local call target: entry label of a function with the arity in operand 0
+a  atom
+i  import index
+L  number of live x registers: x0..L-1 must be live, the rest are dead after
+u  no register use: numbers, literals, flags, allocation lists
+S  list of sources
+D  list of destination registers
+P  list of (value, label) pairs (select_val, select_tuple_arity)
+M  list of (key, destination) pairs (get_map_elements)
+B  bs_match command list, see bs_match_commands
+
+Instructions without V_KEEP_HEAP may garbage collect, which drops the heap
+reserved by test_heap. Instructions with V_END do not fall through. Only
+V_FLOAT instructions may name float registers.
+V_OBSOLETE instructions are no longer emitted by the compiler, modules
+using them are rejected like OTP does (they have to be re-compiled).
+Opcodes that change the frame, call out or build on the heap are handled
+by name in step(), the roles of those are still used for the bounds checks.
+*/
+#define V_KEEP_HEAP 1
+#define V_END       2
+#define V_OBSOLETE  4
+#define V_FLOAT     8
+
+typedef struct {
+    const char *roles;
+    int flags;
+} OpRule;
+
+#define K V_KEEP_HEAP
+#define E V_END
+
+static const OpRule rules[MAX_OPCODE + 1] = {
+    [op_label]                = { "u",        K },
+    [op_func_info]            = { "aau",      K | E },
+    [op_int_code_end]         = { "",         K | E },
+    [op_call]                 = { "uc",       0 },
+    [op_call_last]            = { "ucu",      E },
+    [op_call_only]            = { "uc",       E },
+    [op_call_ext]             = { "ui",       0 },
+    [op_call_ext_last]        = { "uiu",      E },
+    [op_bif0]                 = { "id",       K },
+    [op_bif1]                 = { "lisd",     K },
+    [op_bif2]                 = { "lissd",    K },
+    [op_allocate]             = { "uL",       0 },
+    [op_allocate_heap]        = { "uuL",      0 },
+    [op_allocate_zero]        = { "uL",       0 },
+    [op_allocate_heap_zero]   = { "uuL",      0 },
+    [op_test_heap]            = { "uL",       0 },
+    [op_init]                 = { "d",        K },
+    [op_deallocate]           = { "u",        K },
+    [op_return]               = { "",         K | E },
+    [op_send]                 = { "",         0 },
+    [op_remove_message]       = { "",         K },
+    [op_timeout]              = { "",         K },
+    [op_loop_rec]             = { "ld",       K },
+    [op_loop_rec_end]         = { "l",        K | E },
+    [op_wait]                 = { "l",        E },
+    [op_wait_timeout]         = { "ls",       0 },
+    [op_m_plus]               = { NULL,       V_OBSOLETE },
+    [op_m_minus]              = { NULL,       V_OBSOLETE },
+    [op_m_times]              = { NULL,       V_OBSOLETE },
+    [op_m_div]                = { NULL,       V_OBSOLETE },
+    [op_int_div]              = { NULL,       V_OBSOLETE },
+    [op_int_rem]              = { NULL,       V_OBSOLETE },
+    [op_int_band]             = { NULL,       V_OBSOLETE },
+    [op_int_bor]              = { NULL,       V_OBSOLETE },
+    [op_int_bxor]             = { NULL,       V_OBSOLETE },
+    [op_int_bsl]              = { NULL,       V_OBSOLETE },
+    [op_int_bsr]              = { NULL,       V_OBSOLETE },
+    [op_int_bnot]             = { NULL,       V_OBSOLETE },
+    [op_is_lt]                = { "lss",      K },
+    [op_is_ge]                = { "lss",      K },
+    [op_is_eq]                = { "lss",      K },
+    [op_is_ne]                = { "lss",      K },
+    [op_is_eq_exact]          = { "lss",      K },
+    [op_is_ne_exact]          = { "lss",      K },
+    [op_is_integer]           = { "ls",       K },
+    [op_is_float]             = { "ls",       K },
+    [op_is_number]            = { "ls",       K },
+    [op_is_atom]              = { "ls",       K },
+    [op_is_pid]               = { "ls",       K },
+    [op_is_reference]         = { "ls",       K },
+    [op_is_port]              = { "ls",       K },
+    [op_is_nil]               = { "ls",       K },
+    [op_is_binary]            = { "ls",       K },
+    [op_is_constant]          = { "ls",       K },
+    [op_is_list]              = { "ls",       K },
+    [op_is_nonempty_list]     = { "ls",       K },
+    [op_is_tuple]             = { "ls",       K },
+    [op_test_arity]           = { "lsu",      K },
+    [op_select_val]           = { "slP",      K | E },
+    [op_select_tuple_arity]   = { "slP",      K | E },
+    [op_jump]                 = { "l",        K | E },
+    [op_catch]                = { "dl",       K },
+    [op_catch_end]            = { "d",        0 },
+    [op_move]                 = { "sd",       K },
+    [op_get_list]             = { "sdd",      K },
+    [op_get_tuple_element]    = { "sud",      K },
+    [op_set_tuple_element]    = { "ssu",      K },
+    [op_put_string]           = { NULL,       V_OBSOLETE },
+    [op_put_list]             = { "ssd",      K },
+    [op_put_tuple]            = { "ud",       K },
+    [op_put]                  = { "s",        K },
+    [op_badmatch]             = { "s",        E },
+    [op_if_end]               = { "",         E },
+    [op_case_end]             = { "s",        E },
+    [op_call_fun]             = { "u",        0 },
+    [op_make_fun]             = { NULL,       V_OBSOLETE },
+    [op_is_function]          = { "ls",       K },
+    [op_call_ext_only]        = { "ui",       E },
+    [op_bs_start_match]       = { NULL,       V_OBSOLETE },
+    [op_bs_get_integer]       = { NULL,       V_OBSOLETE },
+    [op_bs_get_float]         = { NULL,       V_OBSOLETE },
+    [op_bs_get_binary]        = { NULL,       V_OBSOLETE },
+    [op_bs_skip_bits]         = { NULL,       V_OBSOLETE },
+    [op_bs_test_tail]         = { NULL,       V_OBSOLETE },
+    [op_bs_save]              = { NULL,       V_OBSOLETE },
+    [op_bs_restore]           = { NULL,       V_OBSOLETE },
+    [op_bs_init]              = { NULL,       V_OBSOLETE },
+    [op_bs_final]             = { NULL,       V_OBSOLETE },
+    [op_bs_put_integer]       = { "lsuus",    K },
+    [op_bs_put_binary]        = { "lsuus",    K },
+    [op_bs_put_float]         = { "lsuus",    K },
+    [op_bs_put_string]        = { "uu",       K },
+    [op_bs_need_buf]          = { "u",        K },
+    [op_fclearerror]          = { "",         K },
+    [op_fcheckerror]          = { "l",        K },
+    [op_fmove]                = { "sd",       K | V_FLOAT },
+    [op_fconv]                = { "sd",       K | V_FLOAT },
+    [op_fadd]                 = { "lssd",     K | V_FLOAT },
+    [op_fsub]                 = { "lssd",     K | V_FLOAT },
+    [op_fmul]                 = { "lssd",     K | V_FLOAT },
+    [op_fdiv]                 = { "lssd",     K | V_FLOAT },
+    [op_fnegate]              = { "lsd",      K | V_FLOAT },
+    [op_make_fun2]            = { "u",        0 },
+    [op_try]                  = { "dl",       K },
+    [op_try_end]              = { "d",        K },
+    [op_try_case]             = { "d",        0 },
+    [op_try_case_end]         = { "s",        E },
+    [op_raise]                = { "ss",       E },
+    [op_bs_init2]             = { "lsuLud",   0 },
+    [op_bs_bits_to_bytes]     = { "lsd",      K },
+    [op_bs_add]               = { "lssud",    K },
+    [op_apply]                = { "u",        0 },
+    [op_apply_last]           = { "uu",       E },
+    [op_is_boolean]           = { "ls",       K },
+    [op_is_function2]         = { "lss",      K },
+    [op_bs_start_match2]      = { "lsLud",    0 },
+    [op_bs_get_integer2]      = { "lsLsuud",  0 },
+    [op_bs_get_float2]        = { "lsLsuud",  0 },
+    [op_bs_get_binary2]       = { "lsLsuud",  0 },
+    [op_bs_skip_bits2]        = { "lssuu",    K },
+    [op_bs_test_tail2]        = { "lsu",      K },
+    [op_bs_save2]             = { "su",       K },
+    [op_bs_restore2]          = { "su",       K },
+    [op_gc_bif1]              = { "lLisd",    0 },
+    [op_gc_bif2]              = { "lLissd",   0 },
+    [op_bs_final2]            = { NULL,       V_OBSOLETE },
+    [op_bs_bits_to_bytes2]    = { NULL,       V_OBSOLETE },
+    [op_put_literal]          = { NULL,       V_OBSOLETE },
+    [op_is_bitstr]            = { "ls",       K },
+    [op_bs_context_to_binary] = { "s",        0 },
+    [op_bs_test_unit]         = { "lsu",      K },
+    [op_bs_match_string]      = { "lsuu",     K },
+    [op_bs_init_writable]     = { "",         0 },
+    [op_bs_append]            = { "lsuLusud", 0 },
+    [op_bs_private_append]    = { "lsusud",   0 },
+    [op_trim]                 = { "uu",       K },
+    [op_bs_init_bits]         = { "lsuLud",   0 },
+    [op_bs_get_utf8]          = { "lsuud",    K },
+    [op_bs_skip_utf8]         = { "lsuu",     K },
+    [op_bs_get_utf16]         = { "lsuud",    K },
+    [op_bs_skip_utf16]        = { "lsuu",     K },
+    [op_bs_get_utf32]         = { "lsuud",    K },
+    [op_bs_skip_utf32]        = { "lsuu",     K },
+    [op_bs_utf8_size]         = { "lsd",      K },
+    [op_bs_put_utf8]          = { "lus",      K },
+    [op_bs_utf16_size]        = { "lsd",      K },
+    [op_bs_put_utf16]         = { "lus",      K },
+    [op_bs_put_utf32]         = { "lus",      K },
+    [op_on_load]              = { "",         K },
+    [op_recv_mark]            = { "r",        K },
+    [op_recv_set]             = { "r",        K },
+    [op_gc_bif3]              = { "lLisssd",  0 },
+    [op_line]                 = { "u",        K },
+    [op_put_map_assoc]        = { "lsdLS",    0 },
+    [op_put_map_exact]        = { "lsdLS",    0 },
+    [op_is_map]               = { "ls",       K },
+    [op_has_map_fields]       = { "lsS",      K },
+    [op_get_map_elements]     = { "lsM",      K },
+    [op_is_tagged_tuple]      = { "lsua",     K },
+    [op_build_stacktrace]     = { "",         0 },
+    [op_raw_raise]            = { "",         E },
+    [op_get_hd]               = { "sd",       K },
+    [op_get_tl]               = { "sd",       K },
+    [op_put_tuple2]           = { "dS",       K },
+    [op_bs_get_tail]          = { "sdL",      0 },
+    [op_bs_start_match3]      = { "lsLd",     0 },
+    [op_bs_get_position]      = { "sdL",      0 },
+    [op_bs_set_position]      = { "ss",       K },
+    [op_swap]                 = { "ss",       K },
+    [op_bs_start_match4]      = { "lLsd",     0 },
+    [op_make_fun3]            = { "udS",      K },
+    [op_init_yregs]           = { "D",        K },
+    [op_recv_marker_bind]     = { "ss",       K },
+    [op_recv_marker_clear]    = { "s",        K },
+    [op_recv_marker_reserve]  = { "d",        0 },
+    [op_recv_marker_use]      = { "s",        K },
+    [op_bs_create_bin]        = { "luLudS",   0 },
+    [op_call_fun2]            = { "uus",      0 },
+    [op_nif_start]            = { "",         K },
+    [op_badrecord]            = { "s",        E },
+    [op_update_record]        = { "uusdS",    K },
+    [op_bs_match]             = { "lsB",      0 },
+    [op_executable_line]      = { "uu",       K },
+    [op_debug_line]           = { "uuuu",     K },
+};
+
+#undef K
+#undef E
+
+/*
+bs_match Fail Ctx Commands: the commands are one flat list, each one a
+name atom followed by its operands. live and dst are the positions (after
+the name, from 1) of the live register count and of the destination
+register, 0 if the command has none. No other operand may be a register.
+*/
+typedef struct {
+    const char *name;
+    int args;
+    int live;
+    int dst;
+} BsMatchCommand;
+
+static const BsMatchCommand bs_match_commands[] = {
+    { "ensure_at_least", 2, 0, 0 },
+    { "ensure_exactly",  1, 0, 0 },
+    { "integer",         5, 1, 5 },
+    { "binary",          5, 1, 5 },
+    { "skip",            1, 0, 0 },
+    { "get_tail",        3, 1, 3 },
+    { "=:=",             3, 0, 0 },
+};
+
+#define SET_WORDS(n) (((n) + 63) / 64)
+
+typedef struct {
+    int reachable;
+    int frame;                          // y registers allocated, -1 without a stack frame
+    Uint64 heap;                        // words reserved by the last test_heap and not used yet
+    Uint64 x[SET_WORDS(MAX_X_REGS)];    // live x registers
+    Uint64 y[SET_WORDS(MAX_Y_REGS)];    // initialized y registers
+} RegState;
+
+static inline int bit_get(const Uint64 *set, Uint64 i) { return (set[i / 64] >> (i % 64)) & 1; }
+static inline void bit_set(Uint64 *set, Uint64 i) { set[i / 64] |= (Uint64)1 << (i % 64); }
+static inline void bit_clear(Uint64 *set, Uint64 i) { set[i / 64] &= ~((Uint64)1 << (i % 64)); }
+
+typedef struct {
+    const BeamModule *bm;
+    const BeamCode *code;
+    Uint32 *slot;               // label number -> index in states, for labels of the current function
+    RegState *states;           // state on entry of each label of the current function
+    int changed;                // a label state consumed earlier in this pass changed
+
+    // function being checked
+    const char *function;
+    Uint32 arity;
+    usize start, end;           // instruction range
+    usize pos;                  // instruction being checked
+} Validator;
+
+static int fail(const Validator *v, const char *fmt, ...) {
+    const Instr *in = &v->code->instrs[v->pos];
+    const OpInfo *info = opcode_info(in->op);
+    fprintf(stderr, "%s: ", v->bm->module_name ? v->bm->module_name : "?");
+    if (v->function) fprintf(stderr, "%s/%u ", v->function, v->arity);
+    fprintf(stderr, "instruction %zu (%s): ", v->pos, info ? info->name : "?");
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+    return 0;
+}
+
+static const Operand *list_elem(const BeamCode *code, const Operand *list, Uint32 i) {
+    return &code->operands[list->val + i];
+}
+
+static int label_defined(const BeamCode *code, Uint64 label) {
+    return label < code->label_count && code->labels[label] != LABEL_UNDEFINED;
+}
+
+// arity of the function whose entry is label, -1 if label is not a function entry
+static Sint64 entry_arity(const BeamCode *code, Uint64 label) {
+    if (label == 0 || !label_defined(code, label)) return -1;
+    Uint32 at = code->labels[label];
+    if (at == 0 || code->instrs[at - 1].op != op_func_info) return -1;
+    return instr_arg(code, &code->instrs[at - 1], 2)->val;
+}
+
+// words of a fun without its environment, which the compiler counts as words
+#define FUN_SIZE 2
+
+// allocation list kinds
+#define ALLOC_WORDS  0
+#define ALLOC_FLOATS 1
+#define ALLOC_FUNS   2
+
+// heap words of a test_heap style operand: a word count or an allocation list
+static Uint64 alloc_words(const BeamCode *code, const Operand *o) {
+    if (o->type != OPERAND_ALLOC) return (Uint64)o->val;
+    Uint64 words = 0;
+    for (Uint32 i = 0; i < o->len; i++) {
+        Uint64 kind = (Uint64)list_elem(code, o, 2 * i)->val;
+        Uint64 count = (Uint64)list_elem(code, o, 2 * i + 1)->val;
+        // other kinds are rejected by check_bounds
+        if (count > UINT32_MAX) return UINT64_MAX;
+        if (kind == ALLOC_WORDS) words += count;
+        else if (kind == ALLOC_FLOATS) words += count * FLOAT_SIZE;
+        else if (kind == ALLOC_FUNS) words += count * FUN_SIZE;
+    }
+    return words;
+}
+
+/* ---------- bounds checks, done for every instruction ---------- */
+
+static int check_bounds(const Validator *v, const Operand *o) {
+    const BeamModule *bm = v->bm;
+    Uint64 val = (Uint64)o->val;
+    switch (o->type) {
+    case OPERAND_ATOM:
+        if (val > (Uint64)bm->atom_count) return fail(v, "atom %" PRIu64 " out of range", val);
+        return 1;
+    case OPERAND_LITERAL:
+        if (val >= (Uint64)bm->literal_count) return fail(v, "literal %" PRIu64 " out of range", val);
+        return 1;
+    case OPERAND_X:
+        if (val >= MAX_X_REGS) return fail(v, "x%" PRIu64 " out of range", val);
+        return 1;
+    case OPERAND_Y:
+        if (val >= MAX_Y_REGS) return fail(v, "y%" PRIu64 " out of range", val);
+        return 1;
+    case OPERAND_FR:
+        if (val >= MAX_FLOAT_REGS) return fail(v, "fr%" PRIu64 " out of range", val);
+        return 1;
+    case OPERAND_LABEL:
+        if (val != 0 && !label_defined(v->code, val)) return fail(v, "label %" PRIu64 " is not defined", val);
+        return 1;
+    case OPERAND_LIST:
+        for (Uint32 i = 0; i < o->len; i++) {
+            if (!check_bounds(v, list_elem(v->code, o, i))) return 0;
+        }
+        return 1;
+    case OPERAND_ALLOC:
+        for (Uint32 i = 0; i < o->len; i++) {
+            Uint64 kind = (Uint64)list_elem(v->code, o, 2 * i)->val;
+            if (kind > ALLOC_FUNS) return fail(v, "unknown allocation kind %" PRIu64, kind);
+        }
+        return 1;
+    default:
+        return 1;
+    }
+}
+
+static int is_register(const Operand *o) {
+    return o->type == OPERAND_X || o->type == OPERAND_Y;
+}
+
+static int holds_float_register(const BeamCode *code, const Operand *o) {
+    if (o->type == OPERAND_FR) return 1;
+    if (o->type != OPERAND_LIST) return 0;
+    for (Uint32 i = 0; i < o->len; i++) {
+        if (list_elem(code, o, i)->type == OPERAND_FR) return 1;
+    }
+    return 0;
+}
+
+// the bs_match command starting at position i of list, NULL if there is none
+static const BsMatchCommand *bs_match_command(const Validator *v, const Operand *list, Uint32 i) {
+    const Operand *o = list_elem(v->code, list, i);
+    if (o->type != OPERAND_ATOM || o->val == 0 || o->val > v->bm->atom_count) return NULL;
+    const char *name = v->bm->atom_table[o->val - 1].value;
+    for (usize k = 0; k < sizeof(bs_match_commands) / sizeof(bs_match_commands[0]); k++) {
+        const BsMatchCommand *c = &bs_match_commands[k];
+        if (strcmp(c->name, name) == 0) return (Uint64)i + c->args < list->len ? c : NULL;
+    }
+    return NULL;
+}
+
+static int check_bs_match(const Validator *v, const Operand *list) {
+    if (list->type != OPERAND_LIST) return fail(v, "bs_match commands are not a list");
+    for (Uint32 i = 0; i < list->len; ) {
+        const BsMatchCommand *c = bs_match_command(v, list, i);
+        if (!c) return fail(v, "unknown bs_match command at %u", i);
+        for (int k = 1; k <= c->args; k++) {
+            const Operand *o = list_elem(v->code, list, i + k);
+            if (k == c->live && (o->type != OPERAND_U || (Uint64)o->val > MAX_X_REGS)) return fail(v, "bad live register count");
+            if (k == c->dst && !is_register(o)) return fail(v, "bs_match %s destination is not a register", c->name);
+            if (k != c->dst && (is_register(o) || o->type == OPERAND_LIST)) return fail(v, "bs_match %s operand %d is not a constant", c->name, k);
+        }
+        i += 1 + c->args;
+    }
+    return 1;
+}
+
+// arity the import used by an instruction must have, -1 if it is not fixed
+static int import_arity(const Instr *in, const BeamCode *code) {
+    switch (in->op) {
+    case op_bif0: return 0;
+    case op_bif1: return 1;
+    case op_bif2: return 2;
+    case op_gc_bif1: return 1;
+    case op_gc_bif2: return 2;
+    case op_gc_bif3: return 3;
+    case op_call_ext:
+    case op_call_ext_last:
+    case op_call_ext_only:
+        return (int)instr_arg(code, in, 0)->val;
+    default:
+        return -1;
+    }
+}
+
+static int check_operands(const Validator *v, const Instr *in, const OpRule *rule) {
+    const BeamCode *code = v->code;
+    for (int i = 0; i < in->arity; i++) {
+        const Operand *o = instr_arg(code, in, i);
+        Uint64 val = (Uint64)o->val;
+        if (!check_bounds(v, o)) return 0;
+        if (!(rule->flags & V_FLOAT) && holds_float_register(code, o)) {
+            return fail(v, "operand %d is a float register", i);
+        }
+
+        switch (rule->roles[i]) {
+        case 's':
+            if (o->type == OPERAND_LIST || o->type == OPERAND_ALLOC || o->type == OPERAND_LABEL) {
+                return fail(v, "operand %d is not a value", i);
+            }
+            break;
+        case 'd':
+            if (!is_register(o) && o->type != OPERAND_FR) return fail(v, "operand %d is not a register", i);
+            break;
+        case 'l':
+            if (o->type != OPERAND_LABEL && o->type != OPERAND_ATOM) return fail(v, "operand %d is not a label", i);
+            break;
+        case 'r':
+            if (o->type != OPERAND_LABEL) return fail(v, "operand %d is not a label", i);
+            break;
+        case 'c': {
+            Uint64 arity = (Uint64)instr_arg(code, in, 0)->val;
+            if (o->type != OPERAND_LABEL || entry_arity(code, val) < 0) {
+                return fail(v, "call target is not a function entry");
+            }
+            if ((Uint64)entry_arity(code, val) != arity) return fail(v, "call arity %" PRIu64 " does not match the target", arity);
+            break;
+        }
+        case 'a':
+            if (o->type != OPERAND_ATOM || val == 0) return fail(v, "operand %d is not an atom", i);
+            break;
+        case 'i': {
+            if (o->type != OPERAND_U || val >= (Uint64)v->bm->import_count) return fail(v, "import %" PRIu64 " out of range", val);
+            int arity = import_arity(in, code);
+            if (arity >= 0 && v->bm->imports[val].arity != arity) {
+                return fail(v, "import %" PRIu64 " has arity %d, not %d", val, v->bm->imports[val].arity, arity);
+            }
+            break;
+        }
+        case 'L':
+            if (o->type != OPERAND_U || val > MAX_X_REGS) return fail(v, "bad live register count");
+            break;
+        case 'S':
+            if (o->type != OPERAND_LIST) return fail(v, "operand %d is not a list", i);
+            break;
+        case 'D':
+            if (o->type != OPERAND_LIST) return fail(v, "operand %d is not a list", i);
+            for (Uint32 k = 0; k < o->len; k++) {
+                if (!is_register(list_elem(code, o, k))) return fail(v, "destination list holds a non register");
+            }
+            break;
+        case 'B':
+            if (!check_bs_match(v, o)) return 0;
+            break;
+        case 'P':
+        case 'M':
+            if (o->type != OPERAND_LIST || o->len % 2) return fail(v, "operand %d is not a list of pairs", i);
+            for (Uint32 k = 1; k < o->len; k += 2) {
+                const Operand *e = list_elem(code, o, k);
+                if (rule->roles[i] == 'P' && (e->type != OPERAND_LABEL || e->val == 0)) {
+                    return fail(v, "select list holds a non label");
+                }
+                if (rule->roles[i] == 'M' && !is_register(e)) return fail(v, "destination list holds a non register");
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    switch (in->op) {
+    case op_allocate:
+    case op_allocate_zero:
+    case op_allocate_heap:
+    case op_allocate_heap_zero:
+        if ((Uint64)instr_arg(code, in, 0)->val > MAX_Y_REGS) return fail(v, "stack frame too large");
+        break;
+    case op_func_info:
+        if ((Uint64)instr_arg(code, in, 2)->val > MAX_X_REGS) return fail(v, "arity too large");
+        break;
+    case op_fmove:
+        // between a float register and a term
+        if ((instr_arg(code, in, 0)->type == OPERAND_FR) == (instr_arg(code, in, 1)->type == OPERAND_FR)) {
+            return fail(v, "fmove needs exactly one float register");
+        }
+        break;
+    case op_fconv:
+        if (instr_arg(code, in, 0)->type == OPERAND_FR || instr_arg(code, in, 1)->type != OPERAND_FR) {
+            return fail(v, "fconv converts a term into a float register");
+        }
+        break;
+    case op_fadd:
+    case op_fsub:
+    case op_fmul:
+    case op_fdiv:
+    case op_fnegate:
+        // the label comes first, every other operand is a float register
+        for (int i = 1; i < in->arity; i++) {
+            if (instr_arg(code, in, i)->type != OPERAND_FR) return fail(v, "operand %d is not a float register", i);
+        }
+        break;
+    case op_catch:
+    case op_catch_end:
+    case op_try:
+    case op_try_end:
+    case op_try_case:
+        if (instr_arg(code, in, 0)->type != OPERAND_Y) return fail(v, "catch tag is not a y register");
+        break;
+    case op_call:
+    case op_call_last:
+    case op_call_only:
+    case op_call_ext:
+    case op_call_ext_last:
+    case op_call_ext_only:
+    case op_apply:
+    case op_apply_last:
+    case op_call_fun:
+    case op_call_fun2: {
+        if ((Uint64)instr_arg(code, in, 0)->val > MAX_X_REGS - 2) return fail(v, "arity too large");
+        // the stack frame dropped by a tail call
+        int dealloc = in->op == op_apply_last ? 1 : in->op == op_call_last || in->op == op_call_ext_last ? 2 : -1;
+        if (dealloc >= 0 && (Uint64)instr_arg(code, in, dealloc)->val > MAX_Y_REGS) return fail(v, "stack frame too large");
+        break;
+    }
+    default:
+        break;
+    }
+    return 1;
+}
+
+/* ---------- register state ---------- */
+
+static int use(const Validator *v, const RegState *s, const Operand *o) {
+    Uint64 r = (Uint64)o->val;
+    if (o->type == OPERAND_X && !bit_get(s->x, r)) return fail(v, "x%" PRIu64 " is not live", r);
+    if (o->type == OPERAND_Y) {
+        if (s->frame < 0) return fail(v, "y%" PRIu64 " used without a stack frame", r);
+        if (r >= (Uint64)s->frame) return fail(v, "y%" PRIu64 " outside the stack frame of %d", r, s->frame);
+        if (!bit_get(s->y, r)) return fail(v, "y%" PRIu64 " is not initialized", r);
+    }
+    return 1;
+}
+
+static int define(const Validator *v, RegState *s, const Operand *o) {
+    Uint64 r = (Uint64)o->val;
+    if (o->type == OPERAND_X) bit_set(s->x, r);
+    if (o->type == OPERAND_Y) {
+        if (s->frame < 0) return fail(v, "y%" PRIu64 " written without a stack frame", r);
+        if (r >= (Uint64)s->frame) return fail(v, "y%" PRIu64 " outside the stack frame of %d", r, s->frame);
+        bit_set(s->y, r);
+    }
+    return 1;
+}
+
+static int need_live(const Validator *v, const RegState *s, Uint64 live) {
+    for (Uint64 r = 0; r < live; r++) {
+        if (!bit_get(s->x, r)) return fail(v, "x%" PRIu64 " is not live (%" PRIu64 " live registers expected)", r, live);
+    }
+    return 1;
+}
+
+static void kill_from(RegState *s, Uint64 live) {
+    for (Uint64 r = live; r < MAX_X_REGS; r++) bit_clear(s->x, r);
+}
+
+static int use_heap(const Validator *v, RegState *s, Uint64 words) {
+    if (s->heap < words) return fail(v, "needs %" PRIu64 " heap words, %" PRIu64 " reserved", words, s->heap);
+    s->heap -= words;
+    return 1;
+}
+
+// after a call only the result in x0 is live and the heap reservation is gone
+static void after_call(RegState *s) {
+    memset(s->x, 0, sizeof s->x);
+    bit_set(s->x, 0);
+    s->heap = 0;
+}
+
+static int merge(Validator *v, RegState *into, const RegState *from) {
+    if (!from->reachable) return 1;
+    if (!into->reachable) {
+        *into = *from;
+        v->changed = 1;
+        return 1;
+    }
+    if (into->frame != from->frame) {
+        return fail(v, "stack frames of %d and %d meet at a label", into->frame, from->frame);
+    }
+    for (usize i = 0; i < SET_WORDS(MAX_X_REGS); i++) {
+        Uint64 x = into->x[i] & from->x[i];
+        if (x != into->x[i]) { into->x[i] = x; v->changed = 1; }
+    }
+    for (usize i = 0; i < SET_WORDS(MAX_Y_REGS); i++) {
+        Uint64 y = into->y[i] & from->y[i];
+        if (y != into->y[i]) { into->y[i] = y; v->changed = 1; }
+    }
+    if (from->heap < into->heap) {
+        into->heap = from->heap;
+        v->changed = 1;
+    }
+    return 1;
+}
+
+static int branch(Validator *v, const RegState *s, const Operand *o) {
+    if (o->type != OPERAND_LABEL || o->val == 0) return 1;
+    Uint32 at = v->code->labels[o->val];
+    if (at < v->start || at >= v->end) return fail(v, "jump to label %" PRId64 " outside the function", o->val);
+    // forward jumps are picked up later in the same pass
+    int changed = v->changed;
+    if (!merge(v, &v->states[v->slot[o->val]], s)) return 0;
+    if (at > v->pos) v->changed = changed;
+    return 1;
+}
+
+/* ---------- instruction semantics ---------- */
+
+// operands by role, in the order sources, live, branches, destinations
+static int generic(Validator *v, RegState *s, const Instr *in, const OpRule *rule) {
+    const BeamCode *code = v->code;
+    Sint64 live = -1;
+
+    for (int i = 0; i < in->arity; i++) {
+        const Operand *o = instr_arg(code, in, i);
+        switch (rule->roles[i]) {
+        case 's':
+            if (!use(v, s, o)) return 0;
+            break;
+        case 'S':
+            for (Uint32 k = 0; k < o->len; k++) {
+                if (!use(v, s, list_elem(code, o, k))) return 0;
+            }
+            break;
+        case 'P':
+        case 'M':
+            for (Uint32 k = 0; k < o->len; k += 2) {
+                if (!use(v, s, list_elem(code, o, k))) return 0;
+            }
+            break;
+        case 'L':
+            live = o->val;
+            if (!need_live(v, s, (Uint64)live)) return 0;
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (!(rule->flags & V_KEEP_HEAP)) s->heap = 0;
+    if (live >= 0) kill_from(s, (Uint64)live);
+
+    for (int i = 0; i < in->arity; i++) {
+        const Operand *o = instr_arg(code, in, i);
+        if (rule->roles[i] == 'l' && !branch(v, s, o)) return 0;
+        if (rule->roles[i] == 'P') {
+            for (Uint32 k = 1; k < o->len; k += 2) {
+                if (!branch(v, s, list_elem(code, o, k))) return 0;
+            }
+        }
+    }
+
+    for (int i = 0; i < in->arity; i++) {
+        const Operand *o = instr_arg(code, in, i);
+        switch (rule->roles[i]) {
+        case 'd':
+            if (!define(v, s, o)) return 0;
+            break;
+        case 'D':
+            for (Uint32 k = 0; k < o->len; k++) {
+                if (!define(v, s, list_elem(code, o, k))) return 0;
+            }
+            break;
+        case 'M':
+            for (Uint32 k = 1; k < o->len; k += 2) {
+                if (!define(v, s, list_elem(code, o, k))) return 0;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (rule->flags & V_END) s->reachable = 0;
+    return 1;
+}
+
+static int allocate(Validator *v, RegState *s, const Instr *in, int has_heap, int zero) {
+    const BeamCode *code = v->code;
+    Uint64 need = (Uint64)instr_arg(code, in, 0)->val;
+    Uint64 live = (Uint64)instr_arg(code, in, has_heap ? 2 : 1)->val;
+    if (s->frame >= 0) return fail(v, "allocate inside a stack frame");
+    if (!need_live(v, s, live)) return 0;
+    kill_from(s, live);
+    s->frame = (int)need;
+    memset(s->y, 0, sizeof s->y);
+    if (zero) {
+        for (Uint64 r = 0; r < need; r++) bit_set(s->y, r);
+    }
+    s->heap = has_heap ? alloc_words(code, instr_arg(code, in, 1)) : 0;
+    return 1;
+}
+
+// a call that does not return here: frame already dropped, or dropped by the call
+static int tail_call(const Validator *v, RegState *s, Sint64 dealloc) {
+    if (dealloc < 0 && s->frame >= 0) return fail(v, "tail call with a stack frame of %d", s->frame);
+    if (dealloc >= 0 && s->frame != dealloc) {
+        return fail(v, "tail call deallocates %" PRId64 " but the stack frame is %d", dealloc, s->frame);
+    }
+    s->reachable = 0;
+    return 1;
+}
+
+static int step(Validator *v, RegState *s, const Instr *in) {
+    const BeamCode *code = v->code;
+    const OpRule *rule = &rules[in->op];
+    Uint64 a0 = in->arity > 0 ? (Uint64)instr_arg(code, in, 0)->val : 0;
+
+    switch (in->op) {
+    case op_func_info:
+        // reached when a clause does not match: raises function_clause with the arguments
+        if (!need_live(v, s, v->arity)) return 0;
+        s->reachable = 0;
+        return 1;
+
+    case op_call:
+    case op_call_ext:
+        if (!need_live(v, s, a0)) return 0;
+        after_call(s);
+        return 1;
+    case op_call_last:
+    case op_call_ext_last:
+        if (!need_live(v, s, a0)) return 0;
+        return tail_call(v, s, instr_arg(code, in, 2)->val);
+    case op_call_only:
+    case op_call_ext_only:
+        if (!need_live(v, s, a0)) return 0;
+        return tail_call(v, s, -1);
+    case op_apply:
+        // arguments, then module and function
+        if (!need_live(v, s, a0 + 2)) return 0;
+        after_call(s);
+        return 1;
+    case op_apply_last:
+        if (!need_live(v, s, a0 + 2)) return 0;
+        return tail_call(v, s, instr_arg(code, in, 1)->val);
+    case op_call_fun:
+        // arguments, then the fun
+        if (!need_live(v, s, a0 + 1)) return 0;
+        after_call(s);
+        return 1;
+    case op_call_fun2:
+        if (!use(v, s, instr_arg(code, in, 2)) || !need_live(v, s, a0)) return 0;
+        after_call(s);
+        return 1;
+    case op_send:
+        if (!need_live(v, s, 2)) return 0;
+        after_call(s);
+        return 1;
+    case op_build_stacktrace:
+        if (!need_live(v, s, 1)) return 0;
+        after_call(s);
+        return 1;
+    case op_raw_raise:
+        if (!need_live(v, s, 3)) return 0;
+        s->reachable = 0;
+        return 1;
+    case op_make_fun2:
+    case op_bs_init_writable:
+        // the free variables are in x0.., their count is in the FunT chunk
+        after_call(s);
+        return 1;
+
+    case op_allocate:
+        return allocate(v, s, in, 0, 0);
+    case op_allocate_zero:
+        return allocate(v, s, in, 0, 1);
+    case op_allocate_heap:
+        return allocate(v, s, in, 1, 0);
+    case op_allocate_heap_zero:
+        return allocate(v, s, in, 1, 1);
+    case op_test_heap: {
+        Uint64 live = (Uint64)instr_arg(code, in, 1)->val;
+        if (!need_live(v, s, live)) return 0;
+        kill_from(s, live);
+        s->heap = alloc_words(code, instr_arg(code, in, 0));
+        return 1;
+    }
+    case op_deallocate:
+        if (s->frame < 0 || (Uint64)s->frame != a0) {
+            return fail(v, "deallocate %" PRIu64 " but the stack frame is %d", a0, s->frame);
+        }
+        s->frame = -1;
+        memset(s->y, 0, sizeof s->y);
+        return 1;
+    case op_trim: {
+        Uint64 remaining = (Uint64)instr_arg(code, in, 1)->val;
+        if (s->frame < 0 || a0 > (Uint64)s->frame || (Uint64)s->frame - a0 != remaining) {
+            return fail(v, "trim %" PRIu64 " leaving %" PRIu64 " but the stack frame is %d", a0, remaining, s->frame);
+        }
+        for (Uint64 r = 0; r < remaining; r++) {
+            if (bit_get(s->y, r + a0)) bit_set(s->y, r);
+            else bit_clear(s->y, r);
+        }
+        for (Uint64 r = remaining; r < (Uint64)s->frame; r++) bit_clear(s->y, r);
+        s->frame = (int)remaining;
+        return 1;
+    }
+    case op_return:
+        if (!need_live(v, s, 1)) return 0;
+        if (s->frame >= 0) return fail(v, "return with a stack frame of %d", s->frame);
+        s->reachable = 0;
+        return 1;
+
+    case op_catch:
+    case op_try: {
+        // the handler is entered with the catch tag set and the x registers lost
+        if (!define(v, s, instr_arg(code, in, 0))) return 0;
+        RegState handler = *s;
+        memset(handler.x, 0, sizeof handler.x);
+        handler.heap = 0;
+        return branch(v, &handler, instr_arg(code, in, 1));
+    }
+    case op_try_end:
+        if (!use(v, s, instr_arg(code, in, 0))) return 0;
+        bit_clear(s->y, a0);
+        return 1;
+    case op_try_case:
+        // class, reason and stacktrace in x0..x2
+        if (!use(v, s, instr_arg(code, in, 0))) return 0;
+        bit_clear(s->y, a0);
+        memset(s->x, 0, sizeof s->x);
+        for (int r = 0; r < 3; r++) bit_set(s->x, r);
+        s->heap = 0;
+        return 1;
+    case op_bs_match: {
+        const Operand *ctx = instr_arg(code, in, 1), *list = instr_arg(code, in, 2);
+        if (!use(v, s, ctx)) return 0;
+        for (Uint32 i = 0; i < list->len; ) {
+            const BsMatchCommand *c = bs_match_command(v, list, i);
+            // any command can fail, with the destinations of the ones before written
+            if (!branch(v, s, instr_arg(code, in, 0))) return 0;
+            if (c->live) {
+                Uint64 live = (Uint64)list_elem(code, list, i + c->live)->val;
+                if (!need_live(v, s, live)) return 0;
+                kill_from(s, live);
+                s->heap = 0;
+                // the commands after this one still read the context
+                if (!use(v, s, ctx)) return 0;
+            }
+            if (c->dst && !define(v, s, list_elem(code, list, i + c->dst))) return 0;
+            i += 1 + c->args;
+        }
+        return 1;
+    }
+    case op_loop_rec_end:
+    case op_wait:
+    case op_wait_timeout:
+        // the process is scheduled out while it waits and comes back without x registers
+        if (in->op == op_wait_timeout && !use(v, s, instr_arg(code, in, 1))) return 0;
+        memset(s->x, 0, sizeof s->x);
+        s->heap = 0;
+        if (!branch(v, s, instr_arg(code, in, 0))) return 0;
+        // wait_timeout falls through when the timeout expires
+        if (in->op != op_wait_timeout) s->reachable = 0;
+        return 1;
+    case op_catch_end:
+        // x0 holds the value of the catch expression, normal or caught
+        if (!use(v, s, instr_arg(code, in, 0))) return 0;
+        bit_clear(s->y, a0);
+        after_call(s);
+        return 1;
+
+    default:
+        break;
+    }
+
+    if (!generic(v, s, in, rule)) return 0;
+
+    switch (in->op) {
+    case op_put_list:
+        return use_heap(v, s, 2);
+    case op_put_tuple2:
+        return use_heap(v, s, 1 + (Uint64)instr_arg(code, in, 1)->len);
+    case op_put_tuple:
+        // the elements follow as put instructions
+        return use_heap(v, s, 1 + a0);
+    case op_make_fun3:
+        return use_heap(v, s, FUN_SIZE + (Uint64)instr_arg(code, in, 2)->len);
+    case op_update_record:
+        // a copy of the tuple, Size elements and the header
+        return use_heap(v, s, 1 + (Uint64)instr_arg(code, in, 1)->val);
+    case op_fmove:
+        if (instr_arg(code, in, 0)->type == OPERAND_FR && instr_arg(code, in, 1)->type != OPERAND_FR) {
+            return use_heap(v, s, FLOAT_SIZE);
+        }
+        return 1;
+    case op_bs_init2:
+    case op_bs_init_bits:
+    case op_bs_append:
+    case op_bs_create_bin:
+        // reserve heap words for the instructions after the binary construction
+        s->heap = alloc_words(code, instr_arg(code, in, op_bs_create_bin == in->op ? 1 : 2));
+        return 1;
+    default:
+        return 1;
+    }
+}
+
+/* ---------- functions ---------- */
+
+static int validate_function(Validator *v, usize start, usize end, usize func_info) {
+    const BeamCode *code = v->code;
+    const Instr *fi = &code->instrs[func_info];
+    v->pos = func_info;
+    v->function = v->bm->atom_table[instr_arg(code, fi, 1)->val - 1].value;
+    v->arity = (Uint32)instr_arg(code, fi, 2)->val;
+    v->start = start;
+    v->end = end;
+
+    if (func_info + 1 >= end || code->instrs[func_info + 1].op != op_label) {
+        return fail(v, "func_info is not followed by the entry label");
+    }
+
+    // one state per label of this function, all unreachable
+    usize n = 0;
+    for (usize i = start; i < end; i++) {
+        if (code->instrs[i].op == op_label) v->slot[instr_arg(code, &code->instrs[i], 0)->val] = (Uint32)n++;
+    }
+    v->states = calloc(n + 1, sizeof(RegState));
+    if (!v->states) {
+        perror("calloc failed");
+        exit(1);
+    }
+    RegState *s = &v->states[n];
+
+    /*
+    The entry label gets the arguments. The label before func_info is where
+    clauses fail to, it raises function_clause with the same arguments.
+    */
+    RegState *entry = &v->states[v->slot[instr_arg(code, &code->instrs[func_info + 1], 0)->val]];
+    entry->reachable = 1;
+    entry->frame = -1;
+    for (Uint32 r = 0; r < v->arity; r++) bit_set(entry->x, r);
+    v->states[v->slot[instr_arg(code, &code->instrs[start], 0)->val]] = *entry;
+
+    int ok = 1;
+    do {
+        v->changed = 0;
+        s->reachable = 0;
+        for (usize i = start; i < end && ok; i++) {
+            const Instr *in = &code->instrs[i];
+            v->pos = i;
+            if (in->op == op_label) {
+                // falling through into a label merges with the jumps to it
+                RegState *at = &v->states[v->slot[instr_arg(code, in, 0)->val]];
+                int changed = v->changed;
+                ok = merge(v, at, s);
+                v->changed = changed;
+                *s = *at;
+                continue;
+            }
+            if (!s->reachable || in->op == op_line) continue;
+            ok = step(v, s, in);
+        }
+    } while (ok && v->changed);
+
+    // the last instruction must not fall through into the next function
+    if (ok && s->reachable) {
+        v->pos = end - 1;
+        ok = fail(v, "falls off the end of the function");
+    }
+
+    free(v->states);
+    v->states = NULL;
+    return ok;
+}
+
+int validate_module(const BeamModule *bm) {
+    const BeamCode *code = &bm->code;
+    Validator v = { .bm = bm, .code = code };
+
+    if (code->instr_count == 0 || code->instrs[code->instr_count - 1].op != op_int_code_end) {
+        fprintf(stderr, "%s: code does not end with int_code_end\n", bm->module_name);
+        return 0;
+    }
+
+    for (usize i = 0; i < code->instr_count; i++) {
+        const Instr *in = &code->instrs[i];
+        v.pos = i;
+        if (in->op == 0 || in->op > MAX_OPCODE) return fail(&v, "unknown opcode %u", in->op);
+        if (rules[in->op].flags & V_OBSOLETE) return fail(&v, "obsolete instruction, please re-compile the module");
+        if (!rules[in->op].roles) return fail(&v, "unknown opcode %u", in->op);
+        if (strlen(rules[in->op].roles) != in->arity) return fail(&v, "wrong operand count");
+        if (!check_operands(&v, in, &rules[in->op])) return 0;
+        if (in->op == op_int_code_end && i != code->instr_count - 1) return fail(&v, "int_code_end before the end");
+    }
+
+    for (int i = 0; i < bm->export_count; i++) {
+        const ExpT *e = &bm->exports[i];
+        if (e->label < 0 || entry_arity(code, (Uint64)e->label) != e->arity) {
+            fprintf(stderr, "%s: export %s/%d does not point at a function entry\n", bm->module_name, e->name, e->arity);
+            return 0;
+        }
+    }
+
+    v.slot = malloc((code->label_count + 1) * sizeof(Uint32));
+    if (!v.slot) {
+        perror("calloc failed");
+        exit(1);
+    }
+
+    /*
+    Functions are "label; line*; func_info; label (entry); body" and end where
+    the next one starts. Only line instructions may come before the first.
+    */
+    usize start = 0, func_info = 0;
+    int in_function = 0, ok = 1;
+    for (usize i = 0; i < code->instr_count && ok; i++) {
+        const Instr *in = &code->instrs[i];
+        if (in->op != op_func_info && in->op != op_int_code_end) continue;
+
+        usize next = i;
+        if (in->op == op_func_info) {
+            while (next > 0 && code->instrs[next - 1].op == op_line) next--;
+            v.pos = i;
+            if (next == 0 || code->instrs[next - 1].op != op_label) {
+                ok = fail(&v, "func_info without a label before it");
+                break;
+            }
+            next--;
+        }
+        if (in_function) {
+            ok = validate_function(&v, start, next, func_info);
+        } else {
+            for (usize k = 0; k < next && ok; k++) {
+                v.pos = k;
+                if (code->instrs[k].op != op_line) ok = fail(&v, "code outside of a function");
+            }
+        }
+        start = next;
+        func_info = i;
+        in_function = 1;
+    }
+
+    free(v.slot);
+    return ok;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "binary_parsing_helpers.h"
+#include "load.h"
+
+/*
+Load-time code validation.
+
+Runs once per module after all chunks are parsed. It checks the structure
+of the code (registers, stack frames, heap reservations, control flow), not
+the types of terms: the interpreter still has to check its operands, e.g.
+that get_tuple_element reads a tuple with enough elements. Rejects:
+- atom, literal, import and register indexes out of range
+- jumps to undefined labels or out of the function, calls that do not
+  target a function entry of the same arity, bad export entries
+- float registers outside the float instructions, float arithmetic on
+  anything else
+- reads of x registers that are not live and y registers that are not
+  initialized or outside the current stack frame
+- code that can run off the end of its function
+- unbalanced stack frames: allocate inside a frame, return or tail calls
+  with a frame left, deallocate / trim sizes that do not match, paths with
+  different frame sizes meeting at a label
+- heap building (put_list, put_tuple2, put_tuple, make_fun3,
+  update_record, fmove to a register) beyond the words reserved by the
+  last test_heap / allocate_heap, allocation lists with unknown kinds
+
+Each function is interpreted abstractly: the state (live x registers,
+frame size, initialized y registers, reserved heap words) is propagated
+along every branch and merged at labels until nothing changes.
+*/
+#define MAX_X_REGS      1024
+#define MAX_Y_REGS      1024
+#define MAX_FLOAT_REGS  1024
+
+// returns 1 if the code of bm is safe to run, otherwise prints why and returns 0
+int validate_module(const BeamModule *bm);